@@ -0,0 +1,135 @@
+// Benchmark harness for the VM. Runs a fixed corpus of Lox scripts several
+// times each and reports wall time, executed instructions and peak heap
+// usage, so VM changes come with numbers instead of guesses.
+//
+// Build with `cmake --build <build-dir> --target bench`. The scripts are
+// looked up in the source tree by default; pass a directory argument to
+// override.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vm.h"
+
+#ifndef BENCH_SCRIPTS_DIR
+#define BENCH_SCRIPTS_DIR "bench/scripts"
+#endif
+
+#define BENCH_REPEATS 5
+
+static const char* corpus[] = {
+    "fib.lox",
+    "binary_trees.lox",
+    "string_churn.lox",
+    "method_dispatch.lox",
+    "table_stress.lox",
+};
+
+static char* file_read(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+
+    fseek(file, 0l, SEEK_END);
+    size_t file_size = ftell(file);
+    rewind(file);
+
+    char* buffer = (char*)malloc(file_size + 1);
+    if (buffer == NULL)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    size_t byte_read = fread(buffer, sizeof(char), file_size, file);
+    if (byte_read < file_size)
+    {
+        fclose(file);
+        free(buffer);
+        return NULL;
+    }
+
+    buffer[byte_read] = '\0';
+
+    fclose(file);
+    return buffer;
+}
+
+static double now_ms()
+{
+    return (double)clock() * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static bool bench_run(const char* dir, const char* name)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    char* source = file_read(path);
+    if (source == NULL)
+    {
+        fprintf(stderr, "Could not read benchmark '%s'.\n", path);
+        return false;
+    }
+
+    printf("== %s\n", name);
+
+    double best = -1.0;
+    double total = 0.0;
+    uint64_t instructions = 0;
+    size_t peak = 0;
+    bool ok = true;
+
+    for (int rep = 0; rep < BENCH_REPEATS; ++rep)
+    {
+        // Each repetition gets a fresh VM so heap state cannot leak between
+        // runs and the peak measurement stays comparable.
+        vm_init();
+
+        double start = now_ms();
+        InterpretResult result = vm_interpret(source);
+        double elapsed = now_ms() - start;
+
+        instructions = vm.instructions_executed;
+        if (vm.peak_bytes_allocated > peak) peak = vm.peak_bytes_allocated;
+
+        vm_free();
+
+        if (result != INTERPRET_OK)
+        {
+            fprintf(stderr, "Benchmark '%s' failed.\n", name);
+            ok = false;
+            break;
+        }
+
+        total += elapsed;
+        if (best < 0.0 || elapsed < best) best = elapsed;
+    }
+
+    if (ok)
+    {
+        printf("   best %8.2f ms   mean %8.2f ms   %12llu instructions   "
+               "peak %zu bytes\n",
+               best, total / BENCH_REPEATS,
+               (unsigned long long)instructions, peak);
+    }
+
+    free(source);
+    return ok;
+}
+
+int main(int argc, const char* argv[])
+{
+    const char* dir = argc > 1 ? argv[1] : BENCH_SCRIPTS_DIR;
+    int corpus_size = sizeof(corpus) / sizeof(corpus[0]);
+    int failures = 0;
+
+    for (int i = 0; i < corpus_size; ++i)
+    {
+        if (!bench_run(dir, corpus[i])) failures++;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
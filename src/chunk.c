@@ -1,7 +1,9 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "chunk.h"
 #include "memory.h"
+#include "object.h"
 #include "vm.h"
 
 void chunk_init(Chunk* chunk)
@@ -9,14 +11,26 @@ void chunk_init(Chunk* chunk)
     chunk->count = 0;
     chunk->capacity = 0;
     chunk->code = NULL;
+    chunk->line_count = 0;
+    chunk->line_capacity = 0;
     chunk->lines = NULL;
+    chunk->prop_caches = NULL;
     value_array_init(&chunk->constants);
+    chunk->constant_slots = NULL;
+    chunk->constant_slot_capacity = 0;
 }
 
 void chunk_free(Chunk* chunk)
 {
     array_free(uint8_t, chunk->code, chunk->capacity);
-    array_free(int, chunk->lines, chunk->capacity);
+    array_free(LineStart, chunk->lines, chunk->line_capacity);
+
+    if (chunk->prop_caches != NULL)
+        array_free(PropertyCache, chunk->prop_caches, chunk->count);
+
+    if (chunk->constant_slots != NULL)
+        array_free(int, chunk->constant_slots, chunk->constant_slot_capacity);
+
     value_array_free(&chunk->constants);
     chunk_init(chunk);
 }
@@ -30,20 +44,233 @@ void chunk_write(Chunk* chunk, uint8_t byte, int line)
 
         chunk->code =
             array_grow(uint8_t, chunk->code, old_capacity, chunk->capacity);
+    }
+
+    // The peephole folds rewind `count`; drop runs that now start past the
+    // write position so offsets stay monotonic.
+    while (chunk->line_count > 0 &&
+           chunk->lines[chunk->line_count - 1].offset >= chunk->count)
+        chunk->line_count--;
 
-        chunk->lines =
-            array_grow(int, chunk->lines, old_capacity, chunk->capacity);
+    if (chunk->line_count == 0 ||
+        chunk->lines[chunk->line_count - 1].line != line)
+    {
+        if (chunk->line_capacity < chunk->line_count + 1)
+        {
+            int old_capacity = chunk->line_capacity;
+            chunk->line_capacity = capacity_grow(old_capacity);
+
+            chunk->lines = array_grow(LineStart, chunk->lines, old_capacity,
+                                      chunk->line_capacity);
+        }
+
+        chunk->lines[chunk->line_count].offset = chunk->count;
+        chunk->lines[chunk->line_count].line = line;
+        chunk->line_count++;
     }
 
     chunk->code[chunk->count] = byte;
-    chunk->lines[chunk->count] = line;
     chunk->count++;
 }
 
+// Binary search over the runs for the last one starting at or before
+// `offset`.
+int chunk_get_line(Chunk* chunk, int offset)
+{
+    if (chunk->line_count == 0) return 0;
+
+    int low = 0;
+    int high = chunk->line_count - 1;
+
+    while (low < high)
+    {
+        int mid = low + (high - low + 1) / 2;
+
+        if (chunk->lines[mid].offset <= offset)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+
+    return chunk->lines[low].line;
+}
+
+// Byte length of the instruction at `offset`, mirroring the operand
+// layouts debug.c disassembles. OP_CLOSURE is variable: its constant
+// operand plus two bytes per upvalue of the closed-over function.
+int chunk_instruction_length(Chunk* chunk, int offset)
+{
+    switch (chunk->code[offset])
+    {
+        case OP_CONSTANT:
+        case OP_GET_LOCAL:
+        case OP_SET_LOCAL:
+        case OP_GET_GLOBAL:
+        case OP_DEFINE_GLOBAL:
+        case OP_SET_GLOBAL:
+        case OP_GET_GLOBAL_SLOT:
+        case OP_DEFINE_GLOBAL_SLOT:
+        case OP_SET_GLOBAL_SLOT:
+        case OP_GET_UPVALUE:
+        case OP_SET_UPVALUE:
+        case OP_GET_PROPERTY:
+        case OP_SET_PROPERTY:
+        case OP_GET_SUPER:
+        case OP_CALL:
+        case OP_TAIL_CALL:
+        case OP_LIST_INIT:
+        case OP_MAP_GETIDX:
+        case OP_MAP_SETIDX:
+        case OP_ADD_SET_LOCAL:
+        case OP_CLASS:
+        case OP_METHOD:
+            return 2;
+
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+        case OP_LOOP:
+        case OP_INVOKE:
+        case OP_SUPER_INVOKE:
+        case OP_GET_LOCAL_CONST_ADD:
+        case OP_LESS_JUMP_IF_FALSE:
+            return 3;
+
+        case OP_CONSTANT_LONG:
+            return 4;
+
+        case OP_CLOSURE:
+        case OP_CLOSURE_STACK:
+        {
+            ObjFunction* function =
+                obj_as_function(chunk->constants.values[chunk->code[offset + 1]]);
+            return 2 + function->upvalue_count * 2;
+        }
+
+        default:
+            return 1;
+    }
+}
+
+// Dedupe compare. Numbers match bit-exact so the pool keeps 0.0 and -0.0
+// in separate slots even though `==` calls them equal; everything else
+// goes through value_check_equality (one pointer compare for interned
+// strings and other objects).
+static bool constant_same(Value a, Value b)
+{
+#ifdef NAN_BOXING
+    return a == b;
+#else
+    if (a.type != b.type) return false;
+
+    if (value_is_number(a))
+    {
+        double x = value_as_number(a);
+        double y = value_as_number(b);
+        return memcmp(&x, &y, sizeof(double)) == 0;
+    }
+
+    return value_check_equality(a, b);
+#endif
+}
+
+// Hash over the same bits constant_same() compares: the full 64-bit
+// representation when NAN boxed, otherwise the payload bits salted with the
+// type tag so 1.0 and a pointer with the same bit pattern land apart.
+static uint32_t constant_hash(Value value)
+{
+#ifdef NAN_BOXING
+    uint64_t bits = value;
+#else
+    uint64_t bits = 0;
+
+    if (value_is_number(value))
+    {
+        double number = value_as_number(value);
+        memcpy(&bits, &number, sizeof(double));
+    }
+    else if (value_is_obj(value))
+        bits = (uint64_t)(uintptr_t)value_as_obj(value);
+    else if (value_is_bool(value))
+        bits = value_as_bool(value);
+
+    bits ^= (uint64_t)value.type << 56;
+#endif
+
+    return (uint32_t)((bits ^ (bits >> 32)) * 2654435761u);
+}
+
+// Linear probe for `value`. Returns true with the pool index when the
+// constant is already interned, false with the free slot to claim for it.
+static bool constant_slot_find(Chunk* chunk, Value value, int* out_index)
+{
+    uint32_t mask = (uint32_t)chunk->constant_slot_capacity - 1;
+    uint32_t index = constant_hash(value) & mask;
+
+    while (chunk->constant_slots[index] != 0)
+    {
+        int constant = chunk->constant_slots[index] - 1;
+
+        if (constant_same(chunk->constants.values[constant], value))
+        {
+            *out_index = constant;
+            return true;
+        }
+
+        index = (index + 1) & mask;
+    }
+
+    *out_index = (int)index;
+    return false;
+}
+
+static void constant_slots_grow(Chunk* chunk)
+{
+    int old_capacity = chunk->constant_slot_capacity;
+    int* old_slots = chunk->constant_slots;
+
+    chunk->constant_slot_capacity = old_capacity < 64 ? 64 : old_capacity * 2;
+    chunk->constant_slots = mem_alloc(int, chunk->constant_slot_capacity);
+    memset(chunk->constant_slots, 0,
+           chunk->constant_slot_capacity * sizeof(int));
+
+    for (int i = 0; i < old_capacity; ++i)
+    {
+        if (old_slots[i] == 0) continue;
+
+        int slot;
+        constant_slot_find(chunk, chunk->constants.values[old_slots[i] - 1],
+                           &slot);
+        chunk->constant_slots[slot] = old_slots[i];
+    }
+
+    if (old_slots != NULL) array_free(int, old_slots, old_capacity);
+}
+
 int chunk_constant_add(Chunk* chunk, Value value)
 {
+    // Repeated literals and identifiers share one slot, which keeps small
+    // operand indices available longer and shrinks the array gc_mark_array
+    // walks every cycle. The side table makes the lookup one probe instead
+    // of a scan of the whole pool.
     vm_stack_push(value);
+
+    if (chunk->constant_slot_capacity == 0 ||
+        chunk->constants.count + 1 > chunk->constant_slot_capacity / 2)
+        constant_slots_grow(chunk);
+
+    int index;
+    if (constant_slot_find(chunk, value, &index))
+    {
+        vm_stack_pop();
+        return index;
+    }
+
     value_array_write(&chunk->constants, value);
+    chunk->constant_slots[index] = chunk->constants.count;
     vm_stack_pop();
+
+    // The owning function may already be black while it is still compiling.
+    gc_barrier(value);
+
     return chunk->constants.count - 1;
 }
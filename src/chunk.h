@@ -7,6 +7,7 @@
 typedef enum
 {
     OP_CONSTANT,
+    OP_CONSTANT_LONG,
     OP_NIL,
     OP_TRUE,
     OP_FALSE,
@@ -16,6 +17,9 @@ typedef enum
     OP_GET_GLOBAL,
     OP_DEFINE_GLOBAL,
     OP_SET_GLOBAL,
+    OP_GET_GLOBAL_SLOT,
+    OP_DEFINE_GLOBAL_SLOT,
+    OP_SET_GLOBAL_SLOT,
     OP_GET_UPVALUE,
     OP_SET_UPVALUE,
     OP_GET_PROPERTY,
@@ -36,26 +40,72 @@ typedef enum
     OP_JUMP_IF_FALSE,
     OP_LOOP,
     OP_CALL,
+    OP_TAIL_CALL,
     OP_INVOKE,
     OP_SUPER_INVOKE,
     OP_CLOSURE,
+    OP_CLOSURE_STACK,
     OP_CLOSE_UPVALUE,
     OP_LIST_INIT,
     OP_LIST_GETIDX,
     OP_LIST_SETIDX,
+    // Subscripts whose key is a string literal: maps are the only
+    // receiver keyed by strings, so the key folds into the operand and
+    // the access skips the generic subscript's receiver dispatch.
+    OP_MAP_GETIDX,
+    OP_MAP_SETIDX,
+
+    // Fused superinstructions, emitted by the compiler's peephole pass.
+    OP_GET_LOCAL_CONST_ADD,
+    OP_ADD_SET_LOCAL,
+    OP_LESS_JUMP_IF_FALSE,
+
     OP_RETURN,
     OP_CLASS,
     OP_INHERIT,
     OP_METHOD,
+
+    OP_CODE_COUNT, // Keep last; used to size per-opcode tables.
 } OpCode;
 
+// One inline-cache slot per bytecode offset, filled lazily by the VM for
+// property loads and method invokes. `cls` is the last receiver class seen
+// at that call site and `method` the resolved method for it; the GC marks
+// both through the owning function so the cached pointers stay valid.
+typedef struct
+{
+    Obj* cls;
+    Value method;
+} PropertyCache;
+
+// Line info is run-length encoded: one LineStart per source line change,
+// holding the first bytecode offset the line covers. Error paths and the
+// disassembler recover lines through chunk_get_line(), so the per-byte
+// cost of the old parallel `int` array stays out of the cache entirely.
+typedef struct
+{
+    int offset;
+    int line;
+} LineStart;
+
 typedef struct
 {
     int count;
     int capacity;
     uint8_t* code;
-    int* lines;
+    int line_count;
+    int line_capacity;
+    LineStart* lines;
+    PropertyCache* prop_caches;
     ValueArray constants;
+
+    // Open-addressed value -> index map over `constants`, consulted by
+    // chunk_constant_add() so dedupe costs one probe instead of a scan of
+    // the whole pool. Slots store index + 1 (0 marks empty). Compile-time
+    // only: it is never serialized, and the .loxc loader appends constants
+    // directly without touching it.
+    int* constant_slots;
+    int constant_slot_capacity;
 } Chunk;
 
 void chunk_init(Chunk* chunk);
@@ -64,6 +114,10 @@ void chunk_free(Chunk* chunk);
 
 void chunk_write(Chunk* chunk, uint8_t byte, int line);
 
+int chunk_get_line(Chunk* chunk, int offset);
+
+int chunk_instruction_length(Chunk* chunk, int offset);
+
 int chunk_constant_add(Chunk* chunk, Value value);
 
 #endif // CLOX_CHUNK_H_
@@ -49,6 +49,13 @@ typedef struct
     Token name;
     int depth;
     bool is_captured;
+    // Escape analysis for local `fun` declarations: `closure_offset` is
+    // the position of the OP_CLOSURE that initialized this slot (-1 for
+    // ordinary locals) and `closure_escapes` flips as soon as the variable
+    // is used anywhere but call position or gets captured. A closure still
+    // unescaped when its slot dies is rewritten to OP_CLOSURE_STACK.
+    int closure_offset;
+    bool closure_escapes;
 } Local;
 
 typedef struct
@@ -57,6 +64,12 @@ typedef struct
     bool is_local;
 } UpValue;
 
+typedef struct
+{
+    int start;
+    uint8_t op;
+} RecentOp;
+
 typedef enum
 {
     CP_FUNCTION,
@@ -75,6 +88,13 @@ typedef struct Compiler
     int local_count;
     UpValue upvalues[UINT8_COUNT];
     int scope_depth;
+
+    // The last three instructions emitted into this compiler's chunk, used
+    // by the superinstruction fusion and constant folding peepholes in the
+    // emitters below. Three deep so a fold that replaces two literals can
+    // re-expose the instruction before them to further folding.
+    RecentOp recent_ops[3];
+    int recent_op_count;
 } Compiler;
 
 typedef struct ClassCompiler
@@ -83,9 +103,9 @@ typedef struct ClassCompiler
     bool has_super_class;
 } ClassCompiler;
 
-Parser parser;
-Compiler* current_compiler = NULL;
-ClassCompiler* current_class = NULL;
+_Thread_local Parser parser;
+_Thread_local Compiler* current_compiler = NULL;
+_Thread_local ClassCompiler* current_class = NULL;
 
 ///////////////////////////////////////////////////////////////////////////////////////
 // STATIC FUNCTIONS DECLARATIONS, MACROS AND PARSER RULES
@@ -116,10 +136,23 @@ static ParseRule* get_rule(TokenType type);
 
 static uint8_t constant_make(Value value);
 static uint8_t constant_identifier(Token* name);
+static int global_slot_resolve(Token* name);
 static bool token_identifiers_equal(Token* a, Token* b);
+static void fusion_reset();
+static void fusion_record(uint8_t op);
+static bool fusion_try_add();
+static bool fusion_try_set_local(uint8_t slot);
+static bool fusion_try_less_jump();
+static bool fusion_try_tail_call();
+static void fold_rewind(int start, int removed);
+static bool fold_try_binary(TokenType operator_type);
+static bool fold_try_not();
+static bool fold_try_negate();
+static bool fold_try_dead_pop();
 static void byte_emit(uint8_t byte);
+static void byte_emit_literal(uint8_t op);
 static void byte_emit_duo(uint8_t byte1, uint8_t byte2);
-static void byte_emit_var_def(uint8_t global);
+static void byte_emit_var_def(int global);
 static void byte_emit_named_variable(Token name, bool can_assign);
 static void byte_emit_variable(bool can_assign);
 static int byte_emit_jump(uint8_t instruction);
@@ -145,7 +178,7 @@ static void parse_subscript(bool can_assign);
 static void parse_expression();
 
 static Token token_make_synthetic(const char* text);
-static uint8_t parse_variable(const char* error_message);
+static int parse_variable(const char* error_message);
 static uint8_t parse_argument_list();
 static void parse_fun_declaration();
 static void parse_class_method();
@@ -163,7 +196,7 @@ static void parse_while_statement();
 static void parse_for_statement();
 static void parse_expression_statement();
 static void parse_block();
-static void parse_function(CodePlacement code_placement);
+static int parse_function(CodePlacement code_placement);
 static void parse_statement();
 
 static ObjFunction* compiler_finalize();
@@ -229,6 +262,7 @@ static void compiler_init(Compiler* compiler, CodePlacement code_placement)
     compiler->code_placement = code_placement;
     compiler->local_count = 0;
     compiler->scope_depth = 0;
+    compiler->recent_op_count = 0;
     compiler->function = obj_function_new();
     current_compiler = compiler;
 
@@ -236,11 +270,14 @@ static void compiler_init(Compiler* compiler, CodePlacement code_placement)
     {
         current_compiler->function->name =
             obj_string_cpy(parser.previous.start, parser.previous.length);
+        gc_barrier_obj((Obj*)current_compiler->function->name);
     }
 
     Local* local = &current_compiler->locals[current_compiler->local_count++];
     local->depth = 0;
     local->is_captured = false;
+    local->closure_offset = -1;
+    local->closure_escapes = false;
 
     if (code_placement != CP_FUNCTION)
     {
@@ -259,6 +296,17 @@ static void compiler_scope_begin()
     current_compiler->scope_depth++;
 }
 
+// The local's slot is dying: if it held a `fun` declaration that was only
+// ever called, rewrite its OP_CLOSURE in place so the VM frame-allocates
+// it. The guard re-checks the opcode byte out of caution.
+static void compiler_local_retire(Local* local)
+{
+    if (local->closure_offset == -1 || local->closure_escapes) return;
+
+    if (current_chunk()->code[local->closure_offset] == OP_CLOSURE)
+        current_chunk()->code[local->closure_offset] = OP_CLOSURE_STACK;
+}
+
 static void compiler_scope_end()
 {
     current_compiler->scope_depth--;
@@ -267,6 +315,9 @@ static void compiler_scope_end()
            current_compiler->locals[current_compiler->local_count - 1].depth >
                current_compiler->scope_depth)
     {
+        compiler_local_retire(
+            &current_compiler->locals[current_compiler->local_count - 1]);
+
         if (current_compiler->locals[current_compiler->local_count - 1]
                 .is_captured)
         {
@@ -293,6 +344,8 @@ static void compiler_local_add(Token name)
     local->name = name;
     local->depth = -1;
     local->is_captured = false;
+    local->closure_offset = -1;
+    local->closure_escapes = false;
 }
 
 static int compiler_upvalue_add(Compiler* compiler, uint8_t index,
@@ -351,6 +404,8 @@ static int compiler_upvalue_resolve(Compiler* compiler, Token* name)
 
     {
         compiler->enclosing->locals[local].is_captured = true;
+        // A captured closure can outlive its frame through the capturer.
+        compiler->enclosing->locals[local].closure_escapes = true;
         return compiler_upvalue_add(compiler, (uint8_t)local, true);
     }
 
@@ -505,6 +560,14 @@ static uint8_t constant_identifier(Token* name)
         value_make_obj(obj_string_cpy(name->start, name->length)));
 }
 
+// Resolves a global name to its VM slot index; accesses whose slot fits in
+// a single byte compile down to the slot-indexed opcodes, the rest fall
+// back to the by-name opcodes in the caller.
+static int global_slot_resolve(Token* name)
+{
+    return vm_global_slot(obj_string_cpy(name->start, name->length));
+}
+
 static bool token_identifiers_equal(Token* a, Token* b)
 {
     if (a->length != b->length) return false;
@@ -512,18 +575,307 @@ static bool token_identifiers_equal(Token* a, Token* b)
     return memcmp(a->start, b->start, a->length) == 0;
 }
 
+// Forget the recently emitted instructions so nothing fuses across a jump
+// target; called wherever an offset into the chunk is captured or patched.
+static void fusion_reset()
+{
+    current_compiler->recent_op_count = 0;
+}
+
+static void fusion_record(uint8_t op)
+{
+    Compiler* compiler = current_compiler;
+
+    compiler->recent_ops[2] = compiler->recent_ops[1];
+    compiler->recent_ops[1] = compiler->recent_ops[0];
+    compiler->recent_ops[0].op = op;
+    compiler->recent_ops[0].start = current_chunk()->count;
+
+    if (compiler->recent_op_count < 3) compiler->recent_op_count++;
+}
+
+// [OP_GET_LOCAL s][OP_CONSTANT c] + OP_ADD => [OP_GET_LOCAL_CONST_ADD s c]
+static bool fusion_try_add()
+{
+    Compiler* compiler = current_compiler;
+    Chunk* chunk = current_chunk();
+
+    if (compiler->recent_op_count < 2) return false;
+
+    RecentOp* constant = &compiler->recent_ops[0];
+    RecentOp* local = &compiler->recent_ops[1];
+
+    if (local->op != OP_GET_LOCAL || constant->op != OP_CONSTANT) return false;
+
+    // Both instructions must still sit back to back at the chunk's tail.
+    if (local->start + 2 != constant->start) return false;
+    if (constant->start + 2 != chunk->count) return false;
+
+    chunk->code[local->start] = OP_GET_LOCAL_CONST_ADD;
+    chunk->code[local->start + 2] = chunk->code[local->start + 3];
+    chunk->count--;
+
+    fusion_reset();
+    return true;
+}
+
+// OP_ADD + [OP_SET_LOCAL s] => [OP_ADD_SET_LOCAL s]
+static bool fusion_try_set_local(uint8_t slot)
+{
+    Compiler* compiler = current_compiler;
+    Chunk* chunk = current_chunk();
+
+    if (compiler->recent_op_count < 1) return false;
+
+    RecentOp* add = &compiler->recent_ops[0];
+    if (add->op != OP_ADD || add->start + 1 != chunk->count) return false;
+
+    chunk->code[add->start] = OP_ADD_SET_LOCAL;
+    byte_emit(slot);
+
+    fusion_reset();
+    return true;
+}
+
+// OP_LESS + OP_JUMP_IF_FALSE => OP_LESS_JUMP_IF_FALSE; the caller still
+// emits the two placeholder offset bytes.
+static bool fusion_try_less_jump()
+{
+    Compiler* compiler = current_compiler;
+    Chunk* chunk = current_chunk();
+
+    if (compiler->recent_op_count < 1) return false;
+
+    RecentOp* less = &compiler->recent_ops[0];
+    if (less->op != OP_LESS || less->start + 1 != chunk->count) return false;
+
+    chunk->code[less->start] = OP_LESS_JUMP_IF_FALSE;
+
+    fusion_reset();
+    return true;
+}
+
+// Drops the `removed` newest recorded instructions, rewinding the chunk to
+// `start`. The parallel lines array needs no fixup because chunk_write
+// overwrites both slots on the next emit. Records older than the removed
+// ones shift down and stay live, so a folded result keeps folding with what
+// came before it. Like fusion, folding only ever rewinds instructions still
+// in recent_ops, so it can never remove a jump target: fusion_reset()
+// clears the records at every captured or patched offset.
+static void fold_rewind(int start, int removed)
+{
+    Compiler* compiler = current_compiler;
+
+    for (int i = 0; i + removed < 3; ++i)
+        compiler->recent_ops[i] = compiler->recent_ops[i + removed];
+
+    compiler->recent_op_count = compiler->recent_op_count > removed
+                                    ? compiler->recent_op_count - removed
+                                    : 0;
+
+    current_chunk()->count = start;
+}
+
+// [OP_CONSTANT a][OP_CONSTANT b] + operator folds at compile time when both
+// operands are numbers: arithmetic becomes a single new constant and
+// comparisons become OP_TRUE/OP_FALSE. Everything else stays for the VM.
+static bool fold_try_binary(TokenType operator_type)
+{
+    Compiler* compiler = current_compiler;
+    Chunk* chunk = current_chunk();
+
+    if (compiler->recent_op_count < 2) return false;
+
+    RecentOp* rhs = &compiler->recent_ops[0];
+    RecentOp* lhs = &compiler->recent_ops[1];
+
+    if (lhs->op != OP_CONSTANT || rhs->op != OP_CONSTANT) return false;
+
+    // Both instructions must still sit back to back at the chunk's tail.
+    if (lhs->start + 2 != rhs->start) return false;
+    if (rhs->start + 2 != chunk->count) return false;
+
+    Value a = chunk->constants.values[chunk->code[lhs->start + 1]];
+    Value b = chunk->constants.values[chunk->code[rhs->start + 1]];
+
+    if (!value_is_number(a) || !value_is_number(b)) return false;
+
+    double x = value_as_number(a);
+    double y = value_as_number(b);
+    int start = lhs->start;
+
+    switch (operator_type)
+    {
+        case TOKEN_PLUS:
+            fold_rewind(start, 2);
+            byte_emit_constant(value_make_number(x + y));
+            return true;
+
+        case TOKEN_MINUS:
+            fold_rewind(start, 2);
+            byte_emit_constant(value_make_number(x - y));
+            return true;
+
+        case TOKEN_STAR:
+            fold_rewind(start, 2);
+            byte_emit_constant(value_make_number(x * y));
+            return true;
+
+        case TOKEN_SLASH:
+            fold_rewind(start, 2);
+            byte_emit_constant(value_make_number(x / y));
+            return true;
+
+        case TOKEN_GREATER:
+            fold_rewind(start, 2);
+            byte_emit_literal(x > y ? OP_TRUE : OP_FALSE);
+            return true;
+
+        case TOKEN_GREATER_EQUAL:
+            fold_rewind(start, 2);
+            byte_emit_literal(x >= y ? OP_TRUE : OP_FALSE);
+            return true;
+
+        case TOKEN_LESS:
+            fold_rewind(start, 2);
+            byte_emit_literal(x < y ? OP_TRUE : OP_FALSE);
+            return true;
+
+        case TOKEN_LESS_EQUAL:
+            fold_rewind(start, 2);
+            byte_emit_literal(x <= y ? OP_TRUE : OP_FALSE);
+            return true;
+
+        case TOKEN_EQUAL_EQUAL:
+            fold_rewind(start, 2);
+            byte_emit_literal(x == y ? OP_TRUE : OP_FALSE);
+            return true;
+
+        case TOKEN_BANG_EQUAL:
+            fold_rewind(start, 2);
+            byte_emit_literal(x != y ? OP_TRUE : OP_FALSE);
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+// !literal flips at compile time; `nil` is falsy so both it and `false`
+// negate to `true`.
+static bool fold_try_not()
+{
+    Compiler* compiler = current_compiler;
+
+    if (compiler->recent_op_count < 1) return false;
+
+    RecentOp* literal = &compiler->recent_ops[0];
+    if (literal->start + 1 != current_chunk()->count) return false;
+
+    if (literal->op != OP_TRUE && literal->op != OP_FALSE &&
+        literal->op != OP_NIL)
+        return false;
+
+    uint8_t folded = literal->op == OP_TRUE ? OP_FALSE : OP_TRUE;
+
+    fold_rewind(literal->start, 1);
+    byte_emit_literal(folded);
+    return true;
+}
+
+// -constant negates at compile time. The folded result is emitted as a new
+// constant rather than mutating the table entry, which other instructions
+// may share.
+static bool fold_try_negate()
+{
+    Compiler* compiler = current_compiler;
+    Chunk* chunk = current_chunk();
+
+    if (compiler->recent_op_count < 1) return false;
+
+    RecentOp* constant = &compiler->recent_ops[0];
+    if (constant->op != OP_CONSTANT) return false;
+    if (constant->start + 2 != chunk->count) return false;
+
+    Value value = chunk->constants.values[chunk->code[constant->start + 1]];
+    if (!value_is_number(value)) return false;
+
+    fold_rewind(constant->start, 1);
+    byte_emit_constant(value_make_number(-value_as_number(value)));
+    return true;
+}
+
+// A call in tail position reuses the caller's frame instead of growing
+// vm.frames. The OP_RETURN the caller emits right after stays: the VM's
+// fast path never reaches it, and callees that cannot reuse the frame
+// (natives, classes, bound methods) fall back to an ordinary call and
+// return through it.
+static bool fusion_try_tail_call()
+{
+    Compiler* compiler = current_compiler;
+    Chunk* chunk = current_chunk();
+
+    if (compiler->recent_op_count < 1) return false;
+
+    RecentOp* call = &compiler->recent_ops[0];
+    if (call->op != OP_CALL || call->start + 2 != chunk->count) return false;
+
+    chunk->code[call->start] = OP_TAIL_CALL;
+
+    fusion_reset();
+    return true;
+}
+
+// An expression statement whose whole expression folded down to a literal
+// has no effect; drop the literal instead of emitting a push/pop pair.
+static bool fold_try_dead_pop()
+{
+    Compiler* compiler = current_compiler;
+    Chunk* chunk = current_chunk();
+
+    if (compiler->recent_op_count < 1) return false;
+
+    RecentOp* last = &compiler->recent_ops[0];
+
+    if (last->op == OP_CONSTANT && last->start + 2 == chunk->count)
+    {
+        fold_rewind(last->start, 1);
+        return true;
+    }
+
+    if ((last->op == OP_TRUE || last->op == OP_FALSE || last->op == OP_NIL) &&
+        last->start + 1 == chunk->count)
+    {
+        fold_rewind(last->start, 1);
+        return true;
+    }
+
+    return false;
+}
+
 static void byte_emit(uint8_t byte)
 {
     chunk_write(current_chunk(), byte, parser.previous.line);
 }
 
+// Emits OP_NIL/OP_TRUE/OP_FALSE and records it so the folding peephole can
+// see literals the same way it sees constants.
+static void byte_emit_literal(uint8_t op)
+{
+    fusion_record(op);
+    byte_emit(op);
+}
+
 static void byte_emit_duo(uint8_t byte1, uint8_t byte2)
 {
     byte_emit(byte1);
     byte_emit(byte2);
 }
 
-static void byte_emit_var_def(uint8_t global)
+// `global` is the slot index for byte-addressable globals; names past the
+// 256th encode `UINT8_MAX + 1 + identifier constant` and define by name at
+// runtime, mirroring the get/set fallback in byte_emit_named_variable().
+static void byte_emit_var_def(int global)
 {
     if (current_compiler->scope_depth > 0)
     {
@@ -531,7 +883,13 @@ static void byte_emit_var_def(uint8_t global)
         return;
     }
 
-    byte_emit_duo(OP_DEFINE_GLOBAL, global);
+    if (global <= UINT8_MAX)
+    {
+        byte_emit_duo(OP_DEFINE_GLOBAL_SLOT, (uint8_t)global);
+        return;
+    }
+
+    byte_emit_duo(OP_DEFINE_GLOBAL, (uint8_t)(global - UINT8_MAX - 1));
 }
 
 static void byte_emit_named_variable(Token name, bool can_assign)
@@ -549,6 +907,11 @@ static void byte_emit_named_variable(Token name, bool can_assign)
         get_op = OP_GET_UPVALUE;
         set_op = OP_SET_UPVALUE;
     }
+    else if ((arg = global_slot_resolve(&name)) <= UINT8_MAX)
+    {
+        get_op = OP_GET_GLOBAL_SLOT;
+        set_op = OP_SET_GLOBAL_SLOT;
+    }
     else
     {
         arg = constant_identifier(&name);
@@ -560,11 +923,25 @@ static void byte_emit_named_variable(Token name, bool can_assign)
     {
         parse_expression();
 
+        if (set_op == OP_SET_LOCAL && fusion_try_set_local((uint8_t)arg))
+            return;
+
         byte_emit_duo(set_op, (uint8_t)arg);
 
         return;
     }
 
+    if (get_op == OP_GET_LOCAL)
+    {
+        // Any read of a local closure outside call position lets the value
+        // flow somewhere the frame can't vouch for.
+        Local* local = &current_compiler->locals[arg];
+        if (local->closure_offset != -1 && !current_token_is(TOKEN_LEFT_PAREN))
+            local->closure_escapes = true;
+
+        fusion_record(OP_GET_LOCAL);
+    }
+
     byte_emit_duo(get_op, (uint8_t)arg);
 }
 
@@ -575,7 +952,9 @@ static void byte_emit_variable(bool can_assign)
 
 static int byte_emit_jump(uint8_t instruction)
 {
-    byte_emit(instruction);
+    if (instruction != OP_JUMP_IF_FALSE || !fusion_try_less_jump())
+        byte_emit(instruction);
+
     byte_emit(0xFF);
     byte_emit(0xFF);
 
@@ -584,6 +963,9 @@ static int byte_emit_jump(uint8_t instruction)
 
 static void byte_emit_patch_jump(int offset)
 {
+    // The next emitted instruction is a jump target now.
+    fusion_reset();
+
     // -2 to adjust for the bytecode for the jump offset itself.
     int jump = current_chunk()->count - offset - 2;
 
@@ -620,7 +1002,30 @@ static void byte_emit_return()
 
 static void byte_emit_constant(Value value)
 {
-    byte_emit_duo(OP_CONSTANT, constant_make(value));
+    int constant = chunk_constant_add(current_chunk(), value);
+
+    if (constant <= UINT8_MAX)
+    {
+        fusion_record(OP_CONSTANT);
+        byte_emit_duo(OP_CONSTANT, (uint8_t)constant);
+        return;
+    }
+
+    if (constant > 0xffffff)
+    {
+        raise_error("Too many constants in one chunk.");
+        return;
+    }
+
+    // A 24-bit operand for literal loads only; opcodes that name things by
+    // constant index (globals, properties, methods) keep their one-byte
+    // operand and the constant_make() limit. The long form never fuses,
+    // but by then the chunk is past the point where the peepholes matter.
+    fusion_record(OP_CONSTANT_LONG);
+    byte_emit(OP_CONSTANT_LONG);
+    byte_emit((uint8_t)((constant >> 16) & 0xff));
+    byte_emit((uint8_t)((constant >> 8) & 0xff));
+    byte_emit((uint8_t)(constant & 0xff));
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -669,6 +1074,8 @@ static void parse_binary(bool can_assign)
     ParseRule* rule = get_rule(operator_type);
     parse_precedence((Precedence)(rule->precedence + 1));
 
+    if (fold_try_binary(operator_type)) return;
+
     switch (operator_type)
     {
         case TOKEN_BANG_EQUAL:
@@ -688,6 +1095,7 @@ static void parse_binary(bool can_assign)
             break;
 
         case TOKEN_LESS:
+            fusion_record(OP_LESS);
             byte_emit(OP_LESS);
             break;
 
@@ -696,7 +1104,11 @@ static void parse_binary(bool can_assign)
             break;
 
         case TOKEN_PLUS:
-            byte_emit(OP_ADD);
+            if (!fusion_try_add())
+            {
+                fusion_record(OP_ADD);
+                byte_emit(OP_ADD);
+            }
             break;
 
         case TOKEN_MINUS:
@@ -729,11 +1141,11 @@ static void parse_unary(bool can_assign)
     switch (operator_type)
     {
         case TOKEN_BANG:
-            byte_emit(OP_NOT);
+            if (!fold_try_not()) byte_emit(OP_NOT);
             break;
 
         case TOKEN_MINUS:
-            byte_emit(OP_NEGATE);
+            if (!fold_try_negate()) byte_emit(OP_NEGATE);
             break;
 
         default:
@@ -756,15 +1168,15 @@ static void parse_literal(bool can_assign)
     switch (parser.previous.type)
     {
         case TOKEN_FALSE:
-            byte_emit(OP_FALSE);
+            byte_emit_literal(OP_FALSE);
             break;
 
         case TOKEN_NIL:
-            byte_emit(OP_NIL);
+            byte_emit_literal(OP_NIL);
             break;
 
         case TOKEN_TRUE:
-            byte_emit(OP_TRUE);
+            byte_emit_literal(OP_TRUE);
             break;
 
         default:
@@ -785,6 +1197,7 @@ static void parse_call(bool can_assign)
     (void)can_assign;
 
     uint8_t argc = parse_argument_list();
+    fusion_record(OP_CALL);
     byte_emit_duo(OP_CALL, argc);
 }
 
@@ -883,11 +1296,50 @@ static void parse_list(bool can_assign)
     byte_emit_duo(OP_LIST_INIT, item_count);
 }
 
+// Recognizes `m["key"]`: the index expression just compiled is a single
+// string constant still sitting at the chunk's tail. Strings only ever key
+// maps, so the constant instruction rewinds and its slot returns to fold
+// into a dedicated map opcode's operand — the access then costs one
+// dispatch like a property load instead of a constant push plus the
+// generic subscript's receiver dispatch. Returns -1 when the pattern does
+// not apply.
+static int subscript_string_key_constant()
+{
+    Compiler* compiler = current_compiler;
+    Chunk* chunk = current_chunk();
+
+    if (compiler->recent_op_count < 1) return -1;
+
+    RecentOp* recent = &compiler->recent_ops[0];
+    if (recent->op != OP_CONSTANT || recent->start + 2 != chunk->count)
+        return -1;
+
+    int constant = chunk->code[recent->start + 1];
+    if (!obj_is_string(chunk->constants.values[constant])) return -1;
+
+    fold_rewind(recent->start, 1);
+    return constant;
+}
+
 static void parse_subscript(bool can_assign)
 {
     parse_precedence(PREC_OR);
     expect_token_or_fail(TOKEN_RIGHT_BRACKET, "Expect ']' after index.");
 
+    int key_constant = subscript_string_key_constant();
+    if (key_constant != -1)
+    {
+        if (can_assign && expect_token(TOKEN_EQUAL))
+        {
+            parse_expression();
+            byte_emit_duo(OP_MAP_SETIDX, (uint8_t)key_constant);
+            return;
+        }
+
+        byte_emit_duo(OP_MAP_GETIDX, (uint8_t)key_constant);
+        return;
+    }
+
     if (can_assign && expect_token(TOKEN_EQUAL))
     {
         parse_expression();
@@ -912,14 +1364,19 @@ static Token token_make_synthetic(const char* text)
     return token;
 }
 
-static uint8_t parse_variable(const char* error_message)
+static int parse_variable(const char* error_message)
 {
     expect_token_or_fail(TOKEN_IDENTIFIER, error_message);
 
     compiler_define_variable();
     if (current_compiler->scope_depth > 0) return 0;
 
-    return constant_identifier(&parser.previous);
+    int slot = global_slot_resolve(&parser.previous);
+    if (slot <= UINT8_MAX) return slot;
+
+    // Late names keep working through the by-name define; see
+    // byte_emit_var_def() for the encoding.
+    return UINT8_MAX + 1 + constant_identifier(&parser.previous);
 }
 
 static uint8_t parse_argument_list()
@@ -948,9 +1405,18 @@ static uint8_t parse_argument_list()
 
 static void parse_fun_declaration()
 {
-    uint8_t global = parse_variable("Expect function name.");
+    int global = parse_variable("Expect function name.");
     compiler_local_mark_initialized();
-    parse_function(CP_FUNCTION);
+    int closure_offset = parse_function(CP_FUNCTION);
+
+    // Local declarations become escape-analysis candidates; globals are
+    // reachable from anywhere and never qualify.
+    if (current_compiler->scope_depth > 0)
+    {
+        current_compiler->locals[current_compiler->local_count - 1]
+            .closure_offset = closure_offset;
+    }
+
     byte_emit_var_def(global);
 }
 
@@ -978,8 +1444,16 @@ static void parse_class_declaration()
     uint8_t name_constant = constant_identifier(&parser.previous);
     compiler_define_variable();
 
+    int global = 0;
+    if (current_compiler->scope_depth == 0)
+    {
+        int slot = global_slot_resolve(&class_name);
+        global = slot <= UINT8_MAX ? slot
+                                   : UINT8_MAX + 1 + (int)name_constant;
+    }
+
     byte_emit_duo(OP_CLASS, name_constant);
-    byte_emit_var_def(name_constant);
+    byte_emit_var_def(global);
 
     ClassCompiler class_compiler;
     class_compiler.has_super_class = false;
@@ -1024,7 +1498,7 @@ static void parse_class_declaration()
 
 static void parse_var_declaration()
 {
-    uint8_t global = parse_variable("Expect variable name.");
+    int global = parse_variable("Expect variable name.");
 
     if (expect_token(TOKEN_EQUAL))
     {
@@ -1073,7 +1547,7 @@ static void parse_and(bool can_assign)
 
     parse_precedence(PREC_AND);
 
-    byte_emit((uint8_t)end_jump);
+    byte_emit_patch_jump(end_jump);
 }
 
 static void parse_or(bool can_assign)
@@ -1142,12 +1616,14 @@ static void parse_return_statement()
 
     parse_expression();
     expect_token_or_fail(TOKEN_SEMICOLON, "Expect ';' after return value.");
+    fusion_try_tail_call();
     byte_emit(OP_RETURN);
 }
 
 static void parse_while_statement()
 {
     int loop_start = current_chunk()->count;
+    fusion_reset();
 
     expect_token_or_fail(TOKEN_LEFT_PAREN, "Expect '(' after 'while'.");
 
@@ -1186,6 +1662,7 @@ static void parse_for_statement()
     }
 
     int loop_start = current_chunk()->count;
+    fusion_reset();
 
     int exit_jump = -1;
     if (!expect_token(TOKEN_SEMICOLON))
@@ -1203,6 +1680,7 @@ static void parse_for_statement()
     {
         int body_jump = byte_emit_jump(OP_JUMP);
         int increment_start = current_chunk()->count;
+        fusion_reset();
 
         parse_expression();
         byte_emit(OP_POP);
@@ -1232,7 +1710,7 @@ static void parse_expression_statement()
     parse_expression();
     expect_token_or_fail(TOKEN_SEMICOLON, "Expect ';' after expression.");
 
-    byte_emit(OP_POP);
+    if (!fold_try_dead_pop()) byte_emit(OP_POP);
 }
 
 static void parse_block()
@@ -1243,7 +1721,9 @@ static void parse_block()
     expect_token_or_fail(TOKEN_RIGHT_BRACE, "Expect '}' after block.");
 }
 
-static void parse_function(CodePlacement code_placement)
+// Returns the offset of the emitted OP_CLOSURE so declarations can patch
+// it once escape analysis has seen every use of the bound variable.
+static int parse_function(CodePlacement code_placement)
 {
     Compiler compiler;
     compiler_init(&compiler, code_placement);
@@ -1260,7 +1740,7 @@ static void parse_function(CodePlacement code_placement)
             if (current_compiler->function->arity > 255)
                 raise_error_at_current("Can't have more than 255 parameters.");
 
-            uint8_t constant = parse_variable("Expect parameter name.");
+            int constant = parse_variable("Expect parameter name.");
             byte_emit_var_def(constant);
 
         } while (expect_token(TOKEN_COMMA));
@@ -1272,6 +1752,8 @@ static void parse_function(CodePlacement code_placement)
     parse_block();
 
     ObjFunction* function = compiler_finalize();
+
+    int closure_offset = current_chunk()->count;
     byte_emit_duo(OP_CLOSURE, constant_make(value_make_obj(function)));
 
     for (int i = 0; i < function->upvalue_count; ++i)
@@ -1279,6 +1761,8 @@ static void parse_function(CodePlacement code_placement)
         byte_emit(compiler.upvalues[i].is_local ? 1 : 0);
         byte_emit(compiler.upvalues[i].index);
     }
+
+    return closure_offset;
 }
 
 static void parse_statement()
@@ -1325,12 +1809,57 @@ static void parse_statement()
 // COMPILATION
 ///////////////////////////////////////////////////////////////////////////////////////
 
+// Forward jumps that land on an unconditional OP_JUMP retarget straight to
+// its final destination, collapsing the jump-to-jump chains nested and/or
+// expressions produce. Only offsets change — no code moves — so line info
+// and every other jump target stay valid. Chains shorten monotonically, so
+// re-running to a fixpoint terminates.
+static void chunk_thread_jumps(Chunk* chunk)
+{
+    bool changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (int offset = 0; offset < chunk->count;
+             offset += chunk_instruction_length(chunk, offset))
+        {
+            uint8_t op = chunk->code[offset];
+            if (op != OP_JUMP && op != OP_JUMP_IF_FALSE &&
+                op != OP_LESS_JUMP_IF_FALSE)
+                continue;
+
+            int jump = (chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+            int target = offset + 3 + jump;
+
+            if (target >= chunk->count || chunk->code[target] != OP_JUMP)
+                continue;
+
+            int hop = (chunk->code[target + 1] << 8) | chunk->code[target + 2];
+            int threaded = jump + 3 + hop;
+            if (threaded > UINT16_MAX) continue;
+
+            chunk->code[offset + 1] = (threaded >> 8) & 0xFF;
+            chunk->code[offset + 2] = threaded & 0xFF;
+            changed = true;
+        }
+    }
+}
+
 static ObjFunction* compiler_finalize()
 {
     byte_emit_return();
 
+    // Locals in the function's outermost scope die with the frame rather
+    // than through compiler_scope_end(); retire them here.
+    for (int i = 0; i < current_compiler->local_count; ++i)
+        compiler_local_retire(&current_compiler->locals[i]);
+
     ObjFunction* function = current_compiler->function;
 
+    if (!parser.had_error) chunk_thread_jumps(&function->chunk);
+
 #ifdef DEBUG_PRINT_CODE
     if (!parser.had_error)
     {
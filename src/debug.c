@@ -14,6 +14,70 @@ void chunk_disassemble(Chunk* chunk, const char* name)
     }
 }
 
+// Mnemonic lookup for instrumentation dumps; the disassembler keeps its own
+// literals so its formatting stays next to each handler.
+static const char* opcode_names[OP_CODE_COUNT] = {
+    [OP_CONSTANT] = "OP_CONSTANT",
+    [OP_CONSTANT_LONG] = "OP_CONSTANT_LONG",
+    [OP_NIL] = "OP_NIL",
+    [OP_TRUE] = "OP_TRUE",
+    [OP_FALSE] = "OP_FALSE",
+    [OP_POP] = "OP_POP",
+    [OP_GET_LOCAL] = "OP_GET_LOCAL",
+    [OP_SET_LOCAL] = "OP_SET_LOCAL",
+    [OP_GET_GLOBAL] = "OP_GET_GLOBAL",
+    [OP_DEFINE_GLOBAL] = "OP_DEFINE_GLOBAL",
+    [OP_SET_GLOBAL] = "OP_SET_GLOBAL",
+    [OP_GET_GLOBAL_SLOT] = "OP_GET_GLOBAL_SLOT",
+    [OP_DEFINE_GLOBAL_SLOT] = "OP_DEFINE_GLOBAL_SLOT",
+    [OP_SET_GLOBAL_SLOT] = "OP_SET_GLOBAL_SLOT",
+    [OP_GET_UPVALUE] = "OP_GET_UPVALUE",
+    [OP_SET_UPVALUE] = "OP_SET_UPVALUE",
+    [OP_GET_PROPERTY] = "OP_GET_PROPERTY",
+    [OP_SET_PROPERTY] = "OP_SET_PROPERTY",
+    [OP_GET_SUPER] = "OP_GET_SUPER",
+    [OP_EQUAL] = "OP_EQUAL",
+    [OP_GREATER] = "OP_GREATER",
+    [OP_LESS] = "OP_LESS",
+    [OP_ADD] = "OP_ADD",
+    [OP_SUBTRACT] = "OP_SUBTRACT",
+    [OP_MULTIPLY] = "OP_MULTIPLY",
+    [OP_DIVIDE] = "OP_DIVIDE",
+    [OP_NOT] = "OP_NOT",
+    [OP_NEGATE] = "OP_NEGATE",
+    [OP_PRINT] = "OP_PRINT",
+    [OP_PRINTLN] = "OP_PRINTLN",
+    [OP_JUMP] = "OP_JUMP",
+    [OP_JUMP_IF_FALSE] = "OP_JUMP_IF_FALSE",
+    [OP_LOOP] = "OP_LOOP",
+    [OP_CALL] = "OP_CALL",
+    [OP_TAIL_CALL] = "OP_TAIL_CALL",
+    [OP_INVOKE] = "OP_INVOKE",
+    [OP_SUPER_INVOKE] = "OP_SUPER_INVOKE",
+    [OP_CLOSURE] = "OP_CLOSURE",
+    [OP_CLOSURE_STACK] = "OP_CLOSURE_STACK",
+    [OP_CLOSE_UPVALUE] = "OP_CLOSE_UPVALUE",
+    [OP_LIST_INIT] = "OP_LIST_INIT",
+    [OP_LIST_GETIDX] = "OP_LIST_GETIDX",
+    [OP_LIST_SETIDX] = "OP_LIST_SETIDX",
+    [OP_MAP_GETIDX] = "OP_MAP_GETIDX",
+    [OP_MAP_SETIDX] = "OP_MAP_SETIDX",
+    [OP_GET_LOCAL_CONST_ADD] = "OP_GET_LOCAL_CONST_ADD",
+    [OP_ADD_SET_LOCAL] = "OP_ADD_SET_LOCAL",
+    [OP_LESS_JUMP_IF_FALSE] = "OP_LESS_JUMP_IF_FALSE",
+    [OP_RETURN] = "OP_RETURN",
+    [OP_CLASS] = "OP_CLASS",
+    [OP_INHERIT] = "OP_INHERIT",
+    [OP_METHOD] = "OP_METHOD",
+};
+
+const char* opcode_name(uint8_t op)
+{
+    if (op >= OP_CODE_COUNT || opcode_names[op] == NULL) return "OP_UNKNOWN";
+
+    return opcode_names[op];
+}
+
 static int instruction_constant(const char* name, Chunk* chunk, int offset)
 {
     uint8_t constant = chunk->code[offset + 1];
@@ -24,6 +88,18 @@ static int instruction_constant(const char* name, Chunk* chunk, int offset)
     return offset + 2;
 }
 
+static int instruction_constant_long(const char* name, Chunk* chunk,
+                                     int offset)
+{
+    int constant = (chunk->code[offset + 1] << 16) |
+                   (chunk->code[offset + 2] << 8) | chunk->code[offset + 3];
+    printf("%-16s %4d '", name, constant);
+    value_print(chunk->constants.values[constant]);
+    puts("'");
+
+    return offset + 4;
+}
+
 static int instruction_invoke(const char* name, Chunk* chunk, int offset)
 {
     uint8_t constant = chunk->code[offset + 1];
@@ -35,6 +111,18 @@ static int instruction_invoke(const char* name, Chunk* chunk, int offset)
     return offset + 3;
 }
 
+static int instruction_local_constant(const char* name, Chunk* chunk,
+                                      int offset)
+{
+    uint8_t slot = chunk->code[offset + 1];
+    uint8_t constant = chunk->code[offset + 2];
+    printf("%-16s %4d %4d '", name, slot, constant);
+    value_print(chunk->constants.values[constant]);
+    puts("'");
+
+    return offset + 3;
+}
+
 static int instruction_simple(const char* name, int offset)
 {
     printf("%s\n", name);
@@ -62,13 +150,15 @@ int instruction_disassemble(Chunk* chunk, int offset)
 {
     printf("%04d ", offset);
 
-    if (offset > 0 && chunk->lines[offset] == chunk->lines[offset - 1])
+    int line = chunk_get_line(chunk, offset);
+
+    if (offset > 0 && chunk_get_line(chunk, offset - 1) == line)
     {
         printf("%s", "   | ");
     }
     else
     {
-        printf("%4d ", chunk->lines[offset]);
+        printf("%4d ", line);
     }
 
     uint8_t instruction = chunk->code[offset];
@@ -77,6 +167,10 @@ int instruction_disassemble(Chunk* chunk, int offset)
         case OP_CONSTANT:
             return instruction_constant("OP_CONSTANT", chunk, offset);
 
+        case OP_CONSTANT_LONG:
+            return instruction_constant_long("OP_CONSTANT_LONG", chunk,
+                                             offset);
+
         case OP_NIL:
             return instruction_simple("OP_NIL", offset);
 
@@ -104,6 +198,15 @@ int instruction_disassemble(Chunk* chunk, int offset)
         case OP_SET_GLOBAL:
             return instruction_constant("OP_SET_GLOBAL", chunk, offset);
 
+        case OP_GET_GLOBAL_SLOT:
+            return instruction_byte("OP_GET_GLOBAL_SLOT", chunk, offset);
+
+        case OP_DEFINE_GLOBAL_SLOT:
+            return instruction_byte("OP_DEFINE_GLOBAL_SLOT", chunk, offset);
+
+        case OP_SET_GLOBAL_SLOT:
+            return instruction_byte("OP_SET_GLOBAL_SLOT", chunk, offset);
+
         case OP_GET_UPVALUE:
             return instruction_byte("OP_GET_UPVALUE", chunk, offset);
 
@@ -164,6 +267,9 @@ int instruction_disassemble(Chunk* chunk, int offset)
         case OP_CALL:
             return instruction_byte("OP_CALL", chunk, offset);
 
+        case OP_TAIL_CALL:
+            return instruction_byte("OP_TAIL_CALL", chunk, offset);
+
         case OP_INVOKE:
             return instruction_invoke("OP_INVOKE", chunk, offset);
 
@@ -171,10 +277,13 @@ int instruction_disassemble(Chunk* chunk, int offset)
             return instruction_invoke("OP_SUPER_INVOKE", chunk, offset);
 
         case OP_CLOSURE:
+        case OP_CLOSURE_STACK:
         {
+            const char* name = opcode_names[instruction];
+
             offset++;
             uint8_t constant = chunk->code[offset++];
-            printf("%-16s %4d ", "OP_CLOSURE", constant);
+            printf("%-16s %4d ", name, constant);
             value_print(chunk->constants.values[constant]);
             printf("\n");
 
@@ -205,6 +314,22 @@ int instruction_disassemble(Chunk* chunk, int offset)
         case OP_LIST_SETIDX:
             return instruction_simple("OP_LIST_SETIDX", offset);
 
+        case OP_MAP_GETIDX:
+            return instruction_constant("OP_MAP_GETIDX", chunk, offset);
+
+        case OP_MAP_SETIDX:
+            return instruction_constant("OP_MAP_SETIDX", chunk, offset);
+
+        case OP_GET_LOCAL_CONST_ADD:
+            return instruction_local_constant("OP_GET_LOCAL_CONST_ADD", chunk,
+                                              offset);
+
+        case OP_ADD_SET_LOCAL:
+            return instruction_byte("OP_ADD_SET_LOCAL", chunk, offset);
+
+        case OP_LESS_JUMP_IF_FALSE:
+            return instruction_jump("OP_LESS_JUMP_IF_FALSE", 1, chunk, offset);
+
         case OP_RETURN:
             return instruction_simple("OP_RETURN", offset);
 
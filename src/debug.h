@@ -7,4 +7,6 @@ void chunk_disassemble(Chunk* chunk, const char* name);
 
 int instruction_disassemble(Chunk* chunk, int offset);
 
+const char* opcode_name(uint8_t op);
+
 #endif // CLOX_DEBUG_H_
@@ -1,34 +1,128 @@
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "chunk.h"
+#include "compiler.h"
 #include "debug.h"
 #include "general.h"
+#include "serialize.h"
 #include "vm.h"
 
 #define CLOX_REPL_EXIT ":q"
 
+// Counts how deep inside brackets the buffered input still is, skipping
+// string literals and // comments so braces inside either don't confuse
+// the prompt. An unterminated string also counts as open.
+static int source_open_depth(const char* source)
+{
+    int depth = 0;
+
+    for (const char* c = source; *c != '\0'; ++c)
+    {
+        switch (*c)
+        {
+            case '(':
+            case '{':
+            case '[':
+                depth++;
+                break;
+
+            case ')':
+            case '}':
+            case ']':
+                if (depth > 0) depth--;
+                break;
+
+            case '"':
+                c++;
+                while (*c != '\0' && *c != '"') c++;
+                if (*c == '\0') return depth + 1;
+                break;
+
+            case '/':
+                if (c[1] == '/')
+                    while (c[1] != '\0' && c[1] != '\n') c++;
+                break;
+        }
+    }
+
+    return depth;
+}
+
+// Reads one complete form into a growable buffer: lines keep accumulating
+// behind a continuation prompt until every opened bracket is closed, so
+// pasted multi-line functions and inputs of any length work. Returns NULL
+// at end of input; the caller owns the buffer.
+static char* repl_form_read()
+{
+    size_t capacity = 256;
+    size_t count = 0;
+    char* buffer = (char*)malloc(capacity);
+    if (buffer == NULL) exit(74);
+    buffer[0] = '\0';
+
+    while (true)
+    {
+        printf("%s", count == 0 ? "> " : ".. ");
+
+        while (true)
+        {
+            if (capacity - count < 256)
+            {
+                capacity *= 2;
+                buffer = (char*)realloc(buffer, capacity);
+                if (buffer == NULL) exit(74);
+            }
+
+            if (!fgets(buffer + count, (int)(capacity - count), stdin))
+            {
+                if (count == 0)
+                {
+                    free(buffer);
+                    return NULL;
+                }
+
+                return buffer;
+            }
+
+            count += strlen(buffer + count);
+            if (count > 0 && buffer[count - 1] == '\n') break;
+        }
+
+        if (source_open_depth(buffer) == 0) return buffer;
+    }
+}
+
 static void repl()
 {
     puts("clox REPL");
     printf("Type '%s' to exit.\n", CLOX_REPL_EXIT);
 
-    char line[1024];
-
     while (true)
     {
-        printf("%s", "> ");
+        char* form = repl_form_read();
 
-        if (!fgets(line, sizeof(line), stdin))
+        if (form == NULL)
         {
             puts("");
             break;
         }
 
-        if (strncmp(line, CLOX_REPL_EXIT, strlen(CLOX_REPL_EXIT)) == 0) break;
+        if (strncmp(form, CLOX_REPL_EXIT, strlen(CLOX_REPL_EXIT)) == 0)
+        {
+            free(form);
+            break;
+        }
 
-        vm_interpret(line);
+        // Re-entered commands hit the session's chunk cache and skip the
+        // compiler; see vm_interpret_repl().
+        vm_interpret_repl(form);
+        free(form);
     }
 }
 
@@ -65,27 +159,148 @@ static char* file_read(const char* path)
     return buffer;
 }
 
+// Maps the file read-only instead of copying it, halving peak memory for
+// large sources. The scanner works off stable pointers into the buffer and
+// every lexeme that outlives the compile is copied into an interned
+// ObjString, so the mapping is released right after interpreting. The
+// scanner needs a NUL after the last byte: the kernel zero-fills the tail
+// of the final page, which covers every size except an exact multiple of
+// the page size — those (and anything mmap refuses) return NULL and the
+// caller falls back to file_read().
+static char* source_map(const char* path, size_t* out_mapped_size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return NULL;
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || !S_ISREG(status.st_mode) ||
+        status.st_size == 0 ||
+        status.st_size % sysconf(_SC_PAGESIZE) == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    char* source = mmap(NULL, (size_t)status.st_size + 1, PROT_READ,
+                        MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (source == MAP_FAILED) return NULL;
+
+    *out_mapped_size = (size_t)status.st_size + 1;
+    return source;
+}
+
+static char* source_load(const char* path, size_t* out_mapped_size)
+{
+    *out_mapped_size = 0;
+
+    char* source = source_map(path, out_mapped_size);
+    return source != NULL ? source : file_read(path);
+}
+
+static void source_release(char* source, size_t mapped_size)
+{
+    if (mapped_size != 0)
+        munmap(source, mapped_size);
+    else
+        free(source);
+}
+
+static bool path_has_suffix(const char* path, const char* suffix)
+{
+    size_t path_length = strlen(path);
+    size_t suffix_length = strlen(suffix);
+
+    return path_length >= suffix_length &&
+           strcmp(path + path_length - suffix_length, suffix) == 0;
+}
+
 static void file_run(const char* path)
 {
-    char* source = file_read(path);
+    InterpretResult result;
+
+    if (path_has_suffix(path, ".loxc"))
+    {
+        // Precompiled bytecode skips the scanner and compiler entirely.
+        ObjFunction* function = serialize_function_read(path);
+        if (function == NULL) exit(65);
+
+        result = vm_interpret_function(function);
+    }
+    else
+    {
+        size_t mapped_size;
+        char* source = source_load(path, &mapped_size);
+        result = vm_interpret(source);
+        source_release(source, mapped_size);
+    }
+
+    if (result == INTERPRET_COMPILE_ERROR) exit(65);
+    if (result == INTERPRET_RUNTIME_ERROR) exit(70);
+}
+
+static void file_compile(const char* path)
+{
+    size_t mapped_size;
+    char* source = source_load(path, &mapped_size);
+    ObjFunction* function = compile(source);
+    source_release(source, mapped_size);
+
+    if (function == NULL) exit(65);
+
+    // Root the function graph while the writer runs.
+    vm_stack_push(value_make_obj(function));
+
+    char out_path[1024];
+    if (path_has_suffix(path, ".lox"))
+    {
+        snprintf(out_path, sizeof(out_path), "%sc", path);
+    }
+    else
+    {
+        snprintf(out_path, sizeof(out_path), "%s.loxc", path);
+    }
+
+    if (!serialize_function_write(function, out_path)) exit(74);
+
+    vm_stack_pop();
+}
+
+// Runs the prelude script, then images the warmed heap so later processes
+// can restore it through CLOX_SNAPSHOT instead of re-running the prelude.
+static void file_snapshot(const char* script_path, const char* image_path)
+{
+    size_t mapped_size;
+    char* source = source_load(script_path, &mapped_size);
     InterpretResult result = vm_interpret(source);
-    free(source);
+    source_release(source, mapped_size);
 
     if (result == INTERPRET_COMPILE_ERROR) exit(65);
     if (result == INTERPRET_RUNTIME_ERROR) exit(70);
+
+    if (!serialize_snapshot_write(image_path)) exit(74);
 }
 
 int main(int argc, const char* argv[])
 {
     vm_init();
 
+    const char* snapshot = getenv("CLOX_SNAPSHOT");
+    if (snapshot != NULL && snapshot[0] != '\0' &&
+        !serialize_snapshot_read(snapshot))
+        exit(74);
+
     if (argc == 1)
         repl();
     else if (argc == 2)
         file_run(argv[1]);
+    else if (argc == 3 && strcmp(argv[1], "-c") == 0)
+        file_compile(argv[2]);
+    else if (argc == 4 && strcmp(argv[1], "-s") == 0)
+        file_snapshot(argv[2], argv[3]);
     else
     {
-        fprintf(stderr, "Usage: clox [path]\n");
+        fprintf(stderr, "Usage: clox [-c path] [-s path image] [path]\n");
     }
 
     // Clean ups
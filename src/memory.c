@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "compiler.h"
 #include "memory.h"
@@ -9,27 +10,205 @@
 #include <stdio.h>
 #endif
 
-#define GC_HEAP_GROW_FACTOR 2
+// Small fixed-size allocations (ObjUpValue, ObjClosure, ObjInstance,
+// ObjBoundMethod, small arrays, ...) are served from chunked slabs with a
+// free list per size class: allocating pops a node and freeing pushes it
+// back, with no malloc lock or fragmentation in between. reallocate()
+// maintains the invariant that every live allocation whose size fits a
+// class came from that class's pool, so the recorded sizes alone tell pool
+// memory and malloc memory apart.
+
+#define POOL_CLASS_STEP 16
+#define POOL_CLASS_COUNT 4
+#define POOL_MAX_SIZE (POOL_CLASS_STEP * POOL_CLASS_COUNT)
+#define POOL_SLAB_NODES 256
+
+typedef struct PoolNode
+{
+    struct PoolNode* next;
+} PoolNode;
+
+typedef struct PoolSlab
+{
+    struct PoolSlab* next;
+} PoolSlab;
+
+static _Thread_local PoolNode* pool_free_lists[POOL_CLASS_COUNT];
+static _Thread_local PoolSlab* pool_slabs = NULL;
+
+static int pool_class_of(size_t size)
+{
+    if (size == 0 || size > POOL_MAX_SIZE) return -1;
+
+    return (int)((size - 1) / POOL_CLASS_STEP);
+}
+
+static void* pool_alloc(int class_index)
+{
+    if (pool_free_lists[class_index] == NULL)
+    {
+        size_t node_size = (size_t)(class_index + 1) * POOL_CLASS_STEP;
+        PoolSlab* slab =
+            malloc(sizeof(PoolSlab) + node_size * POOL_SLAB_NODES);
+
+        if (slab == NULL) exit(1);
+
+        slab->next = pool_slabs;
+        pool_slabs = slab;
+
+        char* nodes = (char*)(slab + 1);
+        for (int i = 0; i < POOL_SLAB_NODES; ++i)
+        {
+            PoolNode* node = (PoolNode*)(nodes + i * node_size);
+            node->next = pool_free_lists[class_index];
+            pool_free_lists[class_index] = node;
+        }
+    }
+
+    PoolNode* node = pool_free_lists[class_index];
+    pool_free_lists[class_index] = node->next;
+    return node;
+}
+
+static void pool_free(void* pointer, int class_index)
+{
+    PoolNode* node = pointer;
+    node->next = pool_free_lists[class_index];
+    pool_free_lists[class_index] = node;
+}
+
+static void pool_release_slabs()
+{
+    PoolSlab* slab = pool_slabs;
+    while (slab != NULL)
+    {
+        PoolSlab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+
+    pool_slabs = NULL;
+    for (int i = 0; i < POOL_CLASS_COUNT; ++i) pool_free_lists[i] = NULL;
+}
+
+// The collector runs as an incremental mark-sweep state machine so no single
+// allocation pays for a whole-heap pause. Crossing `vm.next_gc` starts a
+// cycle; each later allocation then retires a bounded slice of marking or
+// sweeping. The write barriers in `gc_barrier()`/`gc_barrier_obj()` keep an
+// already-scanned object from smuggling an unmarked reference past the
+// marker, and the roots are re-scanned once when marking finishes, so the
+// stack can mutate freely between steps. gc_perform() still runs a full
+// stop-the-world cycle for DEBUG_STRESS_GC and on-demand collections.
+
+typedef enum
+{
+    GC_IDLE,
+    GC_MARKING,
+    GC_SWEEPING,
+} GcPhase;
+
+#define GC_MARK_STEP_BUDGET 64
+#define GC_SWEEP_STEP_BUDGET 64
+
+static _Thread_local GcPhase gc_phase = GC_IDLE;
+static _Thread_local Obj** gc_sweep_slot = NULL;
+static _Thread_local Obj* gc_fresh_objects = NULL;
+
+static void gc_step();
+
+#ifdef VM_STATS
+#include <time.h>
+
+static _Thread_local size_t gc_cycle_reclaimed = 0;
+
+static double gc_stats_now_ms()
+{
+    return (double)clock() * 1000.0 / CLOCKS_PER_SEC;
+}
+
+static void gc_stats_record_pause(double ms)
+{
+    static const double limits[VM_STATS_BUCKET_COUNT - 1] = {0.01, 0.1, 1.0,
+                                                             10.0};
+
+    int bucket = 0;
+    while (bucket < VM_STATS_BUCKET_COUNT - 1 && ms >= limits[bucket])
+        bucket++;
+
+    vm.gc_pause_buckets[bucket]++;
+}
+
+static void gc_stats_record_cycle()
+{
+    static const size_t limits[VM_STATS_BUCKET_COUNT - 1] = {
+        4096, 65536, 1048576, 16777216};
+
+    int bucket = 0;
+    while (bucket < VM_STATS_BUCKET_COUNT - 1 &&
+           gc_cycle_reclaimed >= limits[bucket])
+        bucket++;
+
+    vm.gc_reclaim_buckets[bucket]++;
+    vm.gc_cycles++;
+    gc_cycle_reclaimed = 0;
+}
+#endif
 
 void* reallocate(void* pointer, size_t old_size, size_t new_size)
 {
     vm.bytes_allocated += new_size - old_size;
 
-    if (new_size > old_size)
+#ifdef VM_STATS
+    if (vm.bytes_allocated > vm.peak_bytes_allocated)
+        vm.peak_bytes_allocated = vm.bytes_allocated;
+#endif
+
+    if (new_size > old_size && vm.gc_enabled)
     {
 #ifdef DEBUG_STRESS_GC
         gc_perform();
 #endif
 
-        if (vm.bytes_allocated > vm.next_gc) gc_perform();
+        gc_step();
     }
 
+    int old_class = pool_class_of(old_size);
+    int new_class = pool_class_of(new_size);
+
     if (new_size == 0)
     {
-        free(pointer);
+        if (old_class != -1)
+            pool_free(pointer, old_class);
+        else
+            free(pointer);
+
         return NULL;
     }
 
+    // Shrinks and grows within one size class keep their node.
+    if (old_class != -1 && old_class == new_class) return pointer;
+
+    if (new_class != -1 || old_class != -1)
+    {
+        void* result =
+            new_class != -1 ? pool_alloc(new_class) : malloc(new_size);
+
+        if (result == NULL) exit(1);
+
+        if (old_size > 0)
+        {
+            memcpy(result, pointer,
+                   old_size < new_size ? old_size : new_size);
+
+            if (old_class != -1)
+                pool_free(pointer, old_class);
+            else
+                free(pointer);
+        }
+
+        return result;
+    }
+
     void* result = realloc(pointer, new_size);
     if (result == NULL) exit(1);
     return result;
@@ -65,6 +244,31 @@ void gc_mark_value(Value value)
     if (value_is_obj(value)) gc_mark_obj(value_as_obj(value));
 }
 
+void gc_barrier(Value value)
+{
+    if (gc_phase == GC_MARKING) gc_mark_value(value);
+}
+
+void gc_barrier_obj(Obj* object)
+{
+    if (gc_phase == GC_MARKING) gc_mark_obj(object);
+}
+
+void gc_register_obj(Obj* object)
+{
+    // Objects born while the sweeper is part-way through the list must stay
+    // out of its reach; they rejoin the main list when the cycle ends.
+    if (gc_phase == GC_SWEEPING)
+    {
+        object->next = gc_fresh_objects;
+        gc_fresh_objects = object;
+        return;
+    }
+
+    object->next = vm.objects;
+    vm.objects = object;
+}
+
 static void gc_mark_array(ValueArray* array)
 {
     for (int i = 0; i < array->count; ++i) gc_mark_value(array->values[i]);
@@ -104,6 +308,10 @@ static void gc_blacken_obj(Obj* object)
             break;
         }
 
+        case OBJ_MAP:
+            gc_mark_table(&((ObjMap*)object)->table);
+            break;
+
         case OBJ_CLOSURE:
         {
             ObjClosure* closure = (ObjClosure*)object;
@@ -119,6 +327,18 @@ static void gc_blacken_obj(Obj* object)
             ObjFunction* function = (ObjFunction*)object;
             gc_mark_obj((Obj*)function->name);
             gc_mark_array(&function->chunk.constants);
+
+            // Inline caches hold strong references so cached classes and
+            // methods can never dangle.
+            if (function->chunk.prop_caches != NULL)
+            {
+                for (int i = 0; i < function->chunk.count; ++i)
+                {
+                    gc_mark_obj(function->chunk.prop_caches[i].cls);
+                    gc_mark_value(function->chunk.prop_caches[i].method);
+                }
+            }
+
             break;
         }
 
@@ -127,13 +347,23 @@ static void gc_blacken_obj(Obj* object)
             break;
 
         case OBJ_NATIVE_FN:
+            break;
+
         case OBJ_STRING:
+        {
+            ObjString* string = (ObjString*)object;
+            gc_mark_obj((Obj*)string->rope_left);
+            gc_mark_obj((Obj*)string->rope_right);
             break;
+        }
 
         case OBJ_LIST:
         {
+            // Numeric lists hold no references at all.
             ObjList* list = (ObjList*)object;
-            for (int i = 0; i < list->count; ++i) gc_mark_value(list->items[i]);
+            if (!list->is_numeric)
+                for (int i = 0; i < list->count; ++i)
+                    gc_mark_value(list->items[i]);
 
             break;
         }
@@ -168,6 +398,14 @@ static void object_free(Obj* object)
             break;
         }
 
+        case OBJ_MAP:
+        {
+            ObjMap* map = (ObjMap*)object;
+            table_free(&map->table);
+            mem_free(ObjMap, object);
+            break;
+        }
+
         case OBJ_CLOSURE:
         {
             ObjClosure* closure = (ObjClosure*)object;
@@ -191,7 +429,18 @@ static void object_free(Obj* object)
         case OBJ_STRING:
         {
             ObjString* string = (ObjString*)object;
-            array_free(char, string->chars, string->length + 1);
+
+            // Inline strings were allocated with their characters in the
+            // tail, so the header must be freed at that same size.
+            if (string->chars == string->inline_chars)
+            {
+                reallocate(object, sizeof(ObjString) + string->length + 1, 0);
+                break;
+            }
+
+            if (string->chars != NULL)
+                array_free(char, string->chars, string->length + 1);
+
             mem_free(ObjString, object);
             break;
         }
@@ -203,7 +452,10 @@ static void object_free(Obj* object)
         case OBJ_LIST:
         {
             ObjList* list = (ObjList*)object;
-            array_free(Value*, list->items, list->count);
+            if (list->is_numeric)
+                array_free(double, list->numbers, list->capacity);
+            else
+                array_free(Value, list->items, list->capacity);
             mem_free(ObjList, object);
             break;
         }
@@ -218,11 +470,18 @@ static void gc_mark_roots()
     for (int i = 0; i < vm.frame_count; ++i)
         gc_mark_obj((Obj*)vm.frames[i].closure);
 
-    for (ObjUpValue* upvalue = vm.open_upvalues; upvalue != NULL;
-         upvalue = upvalue->next)
-        gc_mark_obj((Obj*)upvalue);
+    if (vm.open_upvalue_count > 0)
+    {
+        int top = (int)(vm.stack_top - vm.stack);
+        for (int slot = 0; slot < top; ++slot)
+            if (vm.open_upvalues[slot] != NULL)
+                gc_mark_obj((Obj*)vm.open_upvalues[slot]);
+    }
 
-    gc_mark_table(&vm.globals);
+    gc_mark_table(&vm.global_names);
+    gc_mark_array(&vm.global_slots);
+    gc_mark_table(&vm.repl_cache);
+    gc_mark_array(&vm.pins);
 
     gc_mark_compiler_roots();
 
@@ -238,36 +497,104 @@ static void gc_trace_refs()
     }
 }
 
-static void gc_sweep()
+static void gc_mark_step(int budget)
 {
-    Obj* previous = NULL;
-    Obj* object = vm.objects;
+    while (vm.gray_count > 0 && budget-- > 0)
+    {
+        Obj* object = vm.gray_stack[--vm.gray_count];
+        gc_blacken_obj(object);
+    }
+}
 
-    while (object != NULL)
+static void gc_mark_end()
+{
+    // Re-scan the roots: the stack and frames mutate freely between steps,
+    // so only heap writes need barriers while marking is in progress.
+    gc_mark_roots();
+    gc_trace_refs();
+    gc_table_remove_white(&vm.strings);
+
+    gc_phase = GC_SWEEPING;
+    gc_sweep_slot = &vm.objects;
+}
+
+static void gc_sweep_end()
+{
+#ifdef VM_STATS
+    gc_stats_record_cycle();
+#endif
+
+    gc_sweep_slot = NULL;
+
+    while (gc_fresh_objects != NULL)
+    {
+        Obj* next = gc_fresh_objects->next;
+        gc_fresh_objects->next = vm.objects;
+        vm.objects = gc_fresh_objects;
+        gc_fresh_objects = next;
+    }
+
+    gc_phase = GC_IDLE;
+    vm.next_gc = (size_t)(vm.bytes_allocated * vm.gc_grow_factor);
+}
+
+static void gc_sweep_step(int budget)
+{
+#ifdef VM_STATS
+    size_t before = vm.bytes_allocated;
+#endif
+
+    while (*gc_sweep_slot != NULL && budget-- > 0)
     {
+        Obj* object = *gc_sweep_slot;
+
         if (object->is_marked)
         {
             object->is_marked = false;
-            previous = object;
-            object = object->next;
+            gc_sweep_slot = &object->next;
         }
         else
         {
-            Obj* unreached = object;
-            object = object->next;
+            *gc_sweep_slot = object->next;
+            object_free(object);
+        }
+    }
 
-            if (previous != NULL)
-            {
-                previous->next = object;
-            }
-            else
-            {
-                vm.objects = object;
-            }
+#ifdef VM_STATS
+    gc_cycle_reclaimed += before - vm.bytes_allocated;
+#endif
 
-            object_free(unreached);
-        }
+    if (*gc_sweep_slot == NULL) gc_sweep_end();
+}
+
+static void gc_step()
+{
+    if (gc_phase == GC_IDLE && vm.bytes_allocated <= vm.next_gc) return;
+
+#ifdef VM_STATS
+    double start = gc_stats_now_ms();
+#endif
+
+    switch (gc_phase)
+    {
+        case GC_IDLE:
+            gc_mark_roots();
+            gc_phase = GC_MARKING;
+            break;
+
+        case GC_MARKING:
+            gc_mark_step(GC_MARK_STEP_BUDGET);
+            if (vm.gray_count == 0) gc_mark_end();
+            break;
+
+        case GC_SWEEPING:
+            gc_sweep_step(GC_SWEEP_STEP_BUDGET);
+            break;
     }
+
+#ifdef VM_STATS
+    gc_stats_record_pause(gc_stats_now_ms() - start);
+#endif
 }
 
 void gc_perform()
@@ -277,12 +604,25 @@ void gc_perform()
     size_t before = vm.bytes_allocated;
 #endif
 
-    gc_mark_roots();
-    gc_trace_refs();
-    gc_table_remove_white(&vm.strings);
-    gc_sweep();
+#ifdef VM_STATS
+    double start = gc_stats_now_ms();
+#endif
 
-    vm.next_gc = vm.bytes_allocated * GC_HEAP_GROW_FACTOR;
+    // Finish any in-flight incremental cycle, then run a full one.
+    while (gc_phase == GC_SWEEPING) gc_sweep_step(GC_SWEEP_STEP_BUDGET);
+
+    if (gc_phase == GC_IDLE)
+    {
+        gc_mark_roots();
+        gc_phase = GC_MARKING;
+    }
+
+    gc_mark_end();
+    while (gc_phase == GC_SWEEPING) gc_sweep_step(GC_SWEEP_STEP_BUDGET);
+
+#ifdef VM_STATS
+    gc_stats_record_pause(gc_stats_now_ms() - start);
+#endif
 
 #ifdef DEBUG_LOG_GC
     puts("-- gc end");
@@ -301,5 +641,16 @@ void objects_free()
         object = next;
     }
 
+    while (gc_fresh_objects != NULL)
+    {
+        Obj* next = gc_fresh_objects->next;
+        object_free(gc_fresh_objects);
+        gc_fresh_objects = next;
+    }
+
+    gc_phase = GC_IDLE;
+    gc_sweep_slot = NULL;
+
     free(vm.gray_stack);
+    pool_release_slabs();
 }
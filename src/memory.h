@@ -20,6 +20,9 @@
 void* reallocate(void* pointer, size_t old_size, size_t new_size);
 void gc_mark_obj(Obj* object);
 void gc_mark_value(Value value);
+void gc_barrier(Value value);
+void gc_barrier_obj(Obj* object);
+void gc_register_obj(Obj* object);
 void gc_perform();
 void objects_free();
 
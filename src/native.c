@@ -0,0 +1,91 @@
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "native.h"
+#include "vm.h"
+
+void vm_define_native_table(const NativeEntry* entries, int count)
+{
+    for (int i = 0; i < count; ++i)
+        vm_define_native_fn(entries[i].name, entries[i].function);
+}
+
+void vm_pin(Value value)
+{
+    // Growing the pin array can itself collect; keep the value rooted on
+    // the stack until it has landed.
+    vm_stack_push(value);
+    value_array_write(&vm.pins, value);
+    vm_stack_pop();
+}
+
+void vm_unpin(Value value)
+{
+    for (int i = vm.pins.count - 1; i >= 0; --i)
+    {
+        if (!value_check_equality(vm.pins.values[i], value)) continue;
+
+        // Order is irrelevant to the root scan; fill the gap from the end.
+        vm.pins.values[i] = vm.pins.values[vm.pins.count - 1];
+        vm.pins.count--;
+        return;
+    }
+}
+
+// A module that names a path but fails to load or export its init is a
+// deployment error, not something to limp past: bail like the file readers
+// in main.c do.
+static void module_load(const char* path)
+{
+    void* handle = dlopen(path, RTLD_NOW | RTLD_GLOBAL);
+    if (handle == NULL)
+    {
+        fprintf(stderr, "Could not load native module '%s': %s\n", path,
+                dlerror());
+        exit(74);
+    }
+
+    CloxModuleInit init;
+    *(void**)&init = dlsym(handle, CLOX_MODULE_INIT_FN);
+    if (init == NULL)
+    {
+        fprintf(stderr, "Native module '%s' exports no %s().\n", path,
+                CLOX_MODULE_INIT_FN);
+        exit(74);
+    }
+
+    init();
+}
+
+void native_modules_load()
+{
+    const char* list = getenv("CLOX_NATIVE_MODULES");
+    if (list == NULL || list[0] == '\0') return;
+
+    // Walk the colon-separated list without mutating the environment.
+    while (true)
+    {
+        const char* separator = strchr(list, ':');
+        size_t length = separator != NULL ? (size_t)(separator - list)
+                                          : strlen(list);
+
+        if (length > 0)
+        {
+            char path[1024];
+            if (length >= sizeof(path))
+            {
+                fprintf(stderr, "Native module path too long.\n");
+                exit(74);
+            }
+
+            memcpy(path, list, length);
+            path[length] = '\0';
+            module_load(path);
+        }
+
+        if (separator == NULL) break;
+        list = separator + 1;
+    }
+}
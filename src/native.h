@@ -0,0 +1,44 @@
+#ifndef CLOX_NATIVE_H_
+#define CLOX_NATIVE_H_
+
+// The C extension API. A module is an ordinary shared object that exports
+//
+//     void clox_module_init(void);
+//
+// and registers its natives from there, usually through one
+// vm_define_native_table() call. Natives bind to flat global slots exactly
+// like the builtins, so calls from Lox resolve to a single array load.
+// Everything a module needs to build values — obj_string_cpy(),
+// obj_list_new(), value_make_*() — comes in through the headers below;
+// results that must survive across a module's own calls back into the VM
+// are kept alive with vm_pin()/vm_unpin().
+//
+// Modules load at VM startup from $CLOX_NATIVE_MODULES, a colon-separated
+// list of shared-object paths. Worker VMs run the same module inits on
+// their own threads, so per-module state should be _Thread_local like the
+// VM itself.
+
+#include "object.h"
+#include "value.h"
+#include "vm.h"
+
+typedef struct
+{
+    const char* name;
+    NativeFn function;
+} NativeEntry;
+
+void vm_define_native_table(const NativeEntry* entries, int count);
+
+// Roots `value` for the collector until the matching vm_unpin(); pairs
+// nest, and unpinning releases the newest pin of that value.
+void vm_pin(Value value);
+void vm_unpin(Value value);
+
+// The entry point looked up in every loaded module.
+#define CLOX_MODULE_INIT_FN "clox_module_init"
+typedef void (*CloxModuleInit)(void);
+
+void native_modules_load();
+
+#endif // CLOX_NATIVE_H_
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "memory.h"
@@ -16,8 +17,11 @@ static Obj* obj_alloc(size_t size, ObjType type)
     object->type = type;
     object->is_marked = false;
 
-    object->next = vm.objects;
-    vm.objects = object;
+    gc_register_obj(object);
+
+#ifdef VM_STATS
+    vm.alloc_counts[type]++;
+#endif
 
 #ifdef DEBUG_LOG_GC
     printf("%p allocate %zu for %d\n", (void*)object, size, type);
@@ -30,38 +34,112 @@ ObjList* obj_list_new()
 {
     ObjList* list = obj_mem_alloc(ObjList, OBJ_LIST);
     list->items = NULL;
+    list->numbers = NULL;
+    list->is_numeric = true;
     list->count = 0;
     list->capacity = 0;
 
     return list;
 }
 
+// One-way move from unboxed doubles to boxed values, taken the first time
+// a non-number lands in the list. The boxed array is allocated before any
+// field changes, so a collection triggered mid-move still sees a
+// consistent numeric list.
+static void list_deoptimize(ObjList* list)
+{
+    Value* items = NULL;
+    if (list->capacity > 0) items = mem_alloc(Value, list->capacity);
+
+    for (int i = 0; i < list->count; ++i)
+        items[i] = value_make_number(list->numbers[i]);
+
+    array_free(double, list->numbers, list->capacity);
+    list->numbers = NULL;
+    list->items = items;
+    list->is_numeric = false;
+}
+
+// Pre-sizes the backing array so a known number of upcoming writes cannot
+// reallocate. Callers must keep the list reachable since growing allocates.
+void obj_list_reserve(ObjList* list, int capacity)
+{
+    if (capacity <= list->capacity) return;
+
+    if (list->is_numeric)
+        list->numbers =
+            array_grow(double, list->numbers, list->capacity, capacity);
+    else
+        list->items = array_grow(Value, list->items, list->capacity, capacity);
+
+    list->capacity = capacity;
+}
+
 void obj_list_append(ObjList* list, Value value)
 {
+    if (list->is_numeric && !value_is_number(value)) list_deoptimize(list);
+
     if (list->capacity < list->count + 1)
     {
         int old_capacity = list->capacity;
         list->capacity = capacity_grow(old_capacity);
-        list->items =
-            array_grow(Value, list->items, old_capacity, list->capacity);
+
+        if (list->is_numeric)
+            list->numbers = array_grow(double, list->numbers, old_capacity,
+                                       list->capacity);
+        else
+            list->items =
+                array_grow(Value, list->items, old_capacity, list->capacity);
+    }
+
+    if (list->is_numeric)
+    {
+        list->numbers[list->count] = value_as_number(value);
+    }
+    else
+    {
+        list->items[list->count] = value;
+        gc_barrier(value);
     }
 
-    list->items[list->count] = value;
     list->count++;
 }
 
 void obj_list_set(ObjList* list, int index, Value value)
 {
+    if (list->is_numeric)
+    {
+        if (value_is_number(value))
+        {
+            list->numbers[index] = value_as_number(value);
+            return;
+        }
+
+        list_deoptimize(list);
+    }
+
     list->items[index] = value;
+    gc_barrier(value);
 }
 
 Value obj_list_get(ObjList* list, int index)
 {
+    if (list->is_numeric) return value_make_number(list->numbers[index]);
+
     return list->items[index];
 }
 
 void obj_list_delete(ObjList* list, int index)
 {
+    if (list->is_numeric)
+    {
+        for (int i = index; i < list->count - 1; ++i)
+            list->numbers[i] = list->numbers[i + 1];
+
+        list->count--;
+        return;
+    }
+
     for (int i = index; i < list->count - 1; ++i)
         list->items[i] = list->items[i + 1];
 
@@ -102,6 +180,14 @@ ObjInstance* obj_instance_new(ObjClass* cls)
     return instance;
 }
 
+ObjMap* obj_map_new()
+{
+    ObjMap* map = obj_mem_alloc(ObjMap, OBJ_MAP);
+    table_init(&map->table);
+
+    return map;
+}
+
 ObjFunction* obj_function_new()
 {
     ObjFunction* function = obj_mem_alloc(ObjFunction, OBJ_FUNCTION);
@@ -136,31 +222,67 @@ ObjClosure* obj_closure_new(ObjFunction* function)
     return closure;
 }
 
+static ObjString* obj_string_intern(ObjString* string)
+{
+    vm_stack_push(value_make_obj(string));
+    table_set(&vm.strings, string, value_make_nil());
+    vm_stack_pop();
+
+    return string;
+}
+
+// Short strings copy their characters into the tail of the ObjString
+// allocation itself instead of taking ownership of a separate buffer.
+static ObjString* obj_string_allocate_inline(const char* chars, int length,
+                                             uint32_t hash)
+{
+    ObjString* string =
+        (ObjString*)obj_alloc(sizeof(ObjString) + length + 1, OBJ_STRING);
+    string->length = length;
+    string->hash = hash;
+    string->rope_left = NULL;
+    string->rope_right = NULL;
+    memcpy(string->inline_chars, chars, length);
+    string->inline_chars[length] = '\0';
+    string->chars = string->inline_chars;
+
+    return obj_string_intern(string);
+}
+
 static ObjString* obj_string_allocate(char* chars, int length, uint32_t hash)
 {
     ObjString* string = obj_mem_alloc(ObjString, OBJ_STRING);
     string->length = length;
     string->chars = chars;
     string->hash = hash;
+    string->rope_left = NULL;
+    string->rope_right = NULL;
 
-    vm_stack_push(value_make_obj(string));
-    table_set(&vm.strings, string, value_make_nil());
-    vm_stack_pop();
-
-    return string;
+    return obj_string_intern(string);
 }
 
+// FNV-1a folded eight bytes per step with the 64-bit FNV prime instead of
+// one; the zero-padded tail word carries the length in its top byte so
+// strings that differ only in trailing bytes cannot collide trivially. The
+// final fold mixes the high half into the 32 bits the tables use.
 static uint32_t string_hash(const char* key, int length)
 {
-    uint32_t hash = 2166136261u;
+    uint64_t hash = 14695981039346656037ull;
+    const char* end = key + length;
 
-    for (int i = 0; i < length; i++)
+    while (end - key >= 8)
     {
-        hash ^= (uint8_t)key[i];
-        hash *= 16777619;
+        uint64_t word;
+        memcpy(&word, key, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+        key += 8;
     }
 
-    return hash;
+    uint64_t tail = (uint64_t)(uint32_t)length << 56;
+    memcpy(&tail, key, (size_t)(end - key));
+    hash = (hash ^ tail) * 1099511628211ull;
+
+    return (uint32_t)(hash ^ (hash >> 32));
 }
 
 ObjString* obj_string_take(char* chars, int length)
@@ -175,6 +297,13 @@ ObjString* obj_string_take(char* chars, int length)
         return interned;
     }
 
+    if (length <= STRING_INLINE_MAX)
+    {
+        ObjString* string = obj_string_allocate_inline(chars, length, hash);
+        array_free(char, chars, length + 1);
+        return string;
+    }
+
     return obj_string_allocate(chars, length, hash);
 }
 
@@ -186,12 +315,122 @@ ObjString* obj_string_cpy(const char* chars, int length)
 
     if (interned != NULL) return interned;
 
+    if (length <= STRING_INLINE_MAX)
+        return obj_string_allocate_inline(chars, length, hash);
+
     char* head_chars = mem_alloc(char, length + 1);
     memcpy(head_chars, chars, length);
     head_chars[length] = '\0';
     return obj_string_allocate(head_chars, length, hash);
 }
 
+// Below this size the rope bookkeeping costs more than the copy, so short
+// results take the eager interning path.
+#define ROPE_MIN_LENGTH 32
+
+// Concatenation builds a two-child rope node instead of copying; the buffer
+// is materialized lazily by obj_string_chars() on first use. Callers must
+// keep both operands reachable across the call.
+ObjString* obj_string_concat(ObjString* a, ObjString* b)
+{
+    int length = a->length + b->length;
+
+    if (length < ROPE_MIN_LENGTH && a->chars != NULL && b->chars != NULL)
+    {
+        char chars[ROPE_MIN_LENGTH];
+        memcpy(chars, a->chars, a->length);
+        memcpy(chars + a->length, b->chars, b->length);
+        return obj_string_cpy(chars, length);
+    }
+
+    ObjString* rope = obj_mem_alloc(ObjString, OBJ_STRING);
+    rope->length = length;
+    rope->chars = NULL;
+    rope->hash = 0;
+    rope->rope_left = a;
+    rope->rope_right = b;
+    return rope;
+}
+
+static void rope_flatten(ObjString* string)
+{
+    char* chars = mem_alloc(char, string->length + 1);
+
+    // `s = s + piece` loops build very deep left-leaning ropes, so the walk
+    // keeps an explicit stack instead of recursing. The scratch stack stays
+    // plain malloc, like the gray stack, so copying cannot re-enter the GC.
+    int capacity = 8;
+    int count = 0;
+    ObjString** pending = malloc(sizeof(ObjString*) * capacity);
+    if (pending == NULL) exit(1);
+
+    pending[count++] = string;
+    char* out = chars;
+
+    while (count > 0)
+    {
+        ObjString* piece = pending[--count];
+
+        if (piece->chars != NULL)
+        {
+            memcpy(out, piece->chars, piece->length);
+            out += piece->length;
+            continue;
+        }
+
+        if (count + 2 > capacity)
+        {
+            capacity *= 2;
+            pending = realloc(pending, sizeof(ObjString*) * capacity);
+            if (pending == NULL) exit(1);
+        }
+
+        pending[count++] = piece->rope_right;
+        pending[count++] = piece->rope_left;
+    }
+
+    free(pending);
+    chars[string->length] = '\0';
+
+    string->chars = chars;
+    string->hash = string_hash(chars, string->length);
+    string->rope_left = NULL;
+    string->rope_right = NULL;
+
+    // A freshly flattened string joins the intern table unless an equal
+    // string beat it there, so later lookups stay pointer comparisons.
+    if (table_find_string(&vm.strings, chars, string->length, string->hash) ==
+        NULL)
+    {
+        vm_stack_push(value_make_obj(string));
+        table_set(&vm.strings, string, value_make_nil());
+        vm_stack_pop();
+    }
+}
+
+char* obj_string_chars(ObjString* string)
+{
+    if (string->chars == NULL) rope_flatten(string);
+
+    return string->chars;
+}
+
+// Ropes make string identity non-canonical: an unflattened rope can equal an
+// interned string without sharing its pointer. Callers must keep both
+// strings reachable since flattening allocates.
+bool obj_string_equal(ObjString* a, ObjString* b)
+{
+    if (a == b) return true;
+    if (a->length != b->length) return false;
+
+    obj_string_chars(a);
+    obj_string_chars(b);
+
+    if (a->hash != b->hash) return false;
+
+    return memcmp(a->chars, b->chars, a->length) == 0;
+}
+
 static void function_print(ObjFunction* function)
 {
     if (function->name == NULL)
@@ -209,19 +448,37 @@ static void list_print(ObjList* list)
 
     for (int i = 0; i < list->count; ++i)
     {
-        value_print(list->items[i]);
+        value_print(obj_list_get(list, i));
         if (i < list->count - 1) printf(", ");
     }
 
     printf("]");
 }
 
+static void map_print(ObjMap* map)
+{
+    printf("{");
+
+    int printed = 0;
+    for (int i = 0; i < map->table.capacity; ++i)
+    {
+        Entry* entry = &map->table.entries[i];
+        if (entry->key == NULL) continue;
+
+        if (printed > 0) printf(", ");
+        printf("%s: ", obj_string_chars(entry->key));
+        value_print(entry->value);
+        printed++;
+    }
+
+    printf("}");
+}
+
 ObjUpValue* obj_upvalue_new(Value* slot)
 {
     ObjUpValue* upvalue = obj_mem_alloc(ObjUpValue, OBJ_UPVALUE);
     upvalue->closed = value_make_nil();
     upvalue->location = slot;
-    upvalue->next = NULL;
     return upvalue;
 }
 
@@ -254,7 +511,7 @@ void obj_print(Value value)
             break;
 
         case OBJ_STRING:
-            printf("%s", obj_as_cstring(value));
+            printf("%s", obj_string_chars(obj_as_string(value)));
             break;
 
         case OBJ_UPVALUE:
@@ -264,5 +521,112 @@ void obj_print(Value value)
         case OBJ_LIST:
             list_print(obj_as_list(value));
             break;
+
+        case OBJ_MAP:
+            map_print(obj_as_map(value));
+            break;
+    }
+}
+
+static void function_write(ObjFunction* function)
+{
+    if (function->name == NULL)
+    {
+        vm_out_write("<Main Body>", 11);
+        return;
+    }
+
+    vm_out_write("<fn ", 4);
+    vm_out_write(function->name->chars, function->name->length);
+    vm_out_write(">", 1);
+}
+
+static void list_write(ObjList* list)
+{
+    vm_out_write("[", 1);
+
+    for (int i = 0; i < list->count; ++i)
+    {
+        value_write(obj_list_get(list, i));
+        if (i < list->count - 1) vm_out_write(", ", 2);
+    }
+
+    vm_out_write("]", 1);
+}
+
+static void map_write(ObjMap* map)
+{
+    vm_out_write("{", 1);
+
+    int written = 0;
+    for (int i = 0; i < map->table.capacity; ++i)
+    {
+        Entry* entry = &map->table.entries[i];
+        if (entry->key == NULL) continue;
+
+        if (written > 0) vm_out_write(", ", 2);
+        vm_out_write(obj_string_chars(entry->key), entry->key->length);
+        vm_out_write(": ", 2);
+        value_write(entry->value);
+        written++;
+    }
+
+    vm_out_write("}", 1);
+}
+
+// Buffered twin of obj_print(), used on the OP_PRINT/OP_PRINTLN path.
+void obj_write(Value value)
+{
+    switch (obj_get_type(value))
+    {
+        case OBJ_BOUND_METHOD:
+            function_write(obj_as_bound_method(value)->method->function);
+            break;
+
+        case OBJ_CLASS:
+        {
+            ObjString* name = obj_as_class(value)->name;
+            vm_out_write(name->chars, name->length);
+            break;
+        }
+
+        case OBJ_INSTANCE:
+        {
+            ObjString* name = obj_as_instance(value)->cls->name;
+            vm_out_write(name->chars, name->length);
+            vm_out_write(" instance", 9);
+            break;
+        }
+
+        case OBJ_CLOSURE:
+            function_write(obj_as_closure(value)->function);
+            break;
+
+        case OBJ_FUNCTION:
+            function_write(obj_as_function(value));
+            break;
+
+        case OBJ_NATIVE_FN:
+            vm_out_write("<native fn>", 11);
+            break;
+
+        case OBJ_STRING:
+        {
+            ObjString* string = obj_as_string(value);
+            vm_out_write(obj_string_chars(string), string->length);
+            break;
+        }
+
+        case OBJ_UPVALUE:
+            vm_out_write("upvalue", 7);
+            break;
+
+        case OBJ_LIST:
+            list_write(obj_as_list(value));
+            break;
+
+        case OBJ_MAP:
+            map_write(obj_as_map(value));
+            break;
     }
 }
@@ -9,6 +9,7 @@
 #define obj_get_type(value) (value_as_obj(value)->type)
 
 #define obj_is_list(value) (is_object_of_type(value, OBJ_LIST))
+#define obj_is_map(value) (is_object_of_type(value, OBJ_MAP))
 #define obj_is_bound_method(value) (is_object_of_type(value, OBJ_BOUND_METHOD))
 #define obj_is_class(value) (is_object_of_type(value, OBJ_CLASS))
 #define obj_is_instance(value) (is_object_of_type(value, OBJ_INSTANCE))
@@ -18,6 +19,7 @@
 #define obj_is_string(value) (is_object_of_type(value, OBJ_STRING))
 
 #define obj_as_list(value) ((ObjList*)value_as_obj(value))
+#define obj_as_map(value) ((ObjMap*)value_as_obj(value))
 #define obj_as_bound_method(value) ((ObjBoundMethod*)value_as_obj(value))
 #define obj_as_class(value) ((ObjClass*)value_as_obj(value))
 #define obj_as_instance(value) ((ObjInstance*)value_as_obj(value))
@@ -35,11 +37,16 @@ typedef enum
     OBJ_CLOSURE,
     OBJ_FUNCTION,
     OBJ_INSTANCE,
+    OBJ_MAP,
     OBJ_NATIVE_FN,
     OBJ_STRING,
     OBJ_UPVALUE,
 } ObjType;
 
+// Sized as a macro rather than an enum sentinel so switches over ObjType
+// keep their exhaustiveness checks.
+#define OBJ_TYPE_COUNT (OBJ_UPVALUE + 1)
+
 struct Obj
 {
     ObjType type;
@@ -52,7 +59,14 @@ typedef struct
     Obj obj;
     int count;
     int capacity;
+    // A list that has only ever held numbers keeps them unboxed in
+    // `numbers`, so bulk kernels run over a contiguous double array and
+    // the collector skips its elements entirely. The first non-number
+    // write boxes everything into `items` for good; exactly one of the
+    // two arrays is live at a time.
+    bool is_numeric;
     Value* items;
+    double* numbers;
 } ObjList;
 
 typedef struct
@@ -72,12 +86,26 @@ typedef struct
     NativeFn function;
 } ObjNativeFn;
 
+// Strings at or below this many bytes store their characters inside the
+// ObjString allocation itself, so the identifier-sized keys that dominate
+// the intern table cost one allocation and probes touch one cache line.
+#define STRING_INLINE_MAX 23
+
+// A string is either flat (`chars` points at its buffer) or an unflattened
+// rope: `chars` is NULL and the contents are the concatenation of the two
+// rope halves. Ropes make `a + b` O(1); obj_string_chars() materializes the
+// buffer lazily on first use. `hash` is only valid once the string is flat.
 struct ObjString
 {
     Obj obj;
     int length;
     char* chars;
     uint32_t hash;
+    struct ObjString* rope_left;
+    struct ObjString* rope_right;
+    // Short strings keep their characters here and point `chars` at it;
+    // long strings carry a separate buffer and leave this empty.
+    char inline_chars[];
 };
 
 typedef struct ObjUpValue
@@ -85,7 +113,6 @@ typedef struct ObjUpValue
     Obj obj;
     Value* location;
     Value closed;
-    struct ObjUpValue* next;
 } ObjUpValue;
 
 typedef struct
@@ -117,13 +144,24 @@ typedef struct
     ObjClosure* method;
 } ObjBoundMethod;
 
+// A string-keyed dictionary over the open-addressing Table, so scripts get
+// hash lookups without paying for an instance's property machinery.
+typedef struct
+{
+    Obj obj;
+    Table table;
+} ObjMap;
+
 ObjList* obj_list_new();
+void obj_list_reserve(ObjList* list, int capacity);
 void obj_list_append(ObjList* list, Value value);
 void obj_list_set(ObjList* list, int index, Value value);
 Value obj_list_get(ObjList* list, int index);
 void obj_list_delete(ObjList* list, int index);
 bool obj_list_is_valid_index(ObjList* list, int index);
 
+ObjMap* obj_map_new();
+
 ObjBoundMethod* obj_bound_method_new(Value receiver, ObjClosure* method);
 ObjClass* obj_class_new(ObjString* name);
 ObjInstance* obj_instance_new(ObjClass* cls);
@@ -134,10 +172,14 @@ ObjClosure* obj_closure_new(ObjFunction* function);
 
 ObjString* obj_string_take(char* chars, int length);
 ObjString* obj_string_cpy(const char* chars, int length);
+ObjString* obj_string_concat(ObjString* a, ObjString* b);
+char* obj_string_chars(ObjString* string);
+bool obj_string_equal(ObjString* a, ObjString* b);
 
 ObjUpValue* obj_upvalue_new(Value* slot);
 
 void obj_print(Value value);
+void obj_write(Value value);
 
 static inline bool is_object_of_type(Value value, ObjType type)
 {
@@ -0,0 +1,380 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "chunk.h"
+#include "debug.h"
+#include "object.h"
+#include "profiler.h"
+#include "value.h"
+#include "vm.h"
+
+#define PROFILE_SITE_SLOTS 4096 // Power of two; open addressing below.
+#define PROFILE_FN_SLOTS 512
+#define PROFILE_DEFAULT_HZ 1000
+#define PROFILE_REPORT_LINES 25
+#define PROFILE_REPORT_SITES 5
+
+// Per-bytecode-offset self-time samples, aggregated inside the signal
+// handler so a long run costs a fixed amount of memory.
+typedef struct
+{
+    ObjFunction* function;
+    int offset;
+    uint64_t count;
+} SiteSample;
+
+// Per-function on-stack samples; a function is counted once per sample no
+// matter how many frames it occupies.
+typedef struct
+{
+    ObjFunction* function;
+    uint64_t count;
+} FnSample;
+
+static SiteSample sites[PROFILE_SITE_SLOTS];
+static FnSample fns[PROFILE_FN_SLOTS];
+static uint64_t sample_total = 0;
+static uint64_t sample_dropped = 0;
+
+static volatile sig_atomic_t profile_active = 0;
+static pthread_t profile_thread;
+static int profile_hz = PROFILE_DEFAULT_HZ;
+
+// Everything the handler touches is plain loads and stores on the tables
+// above — no allocation, no locks — which keeps it async-signal-safe. A
+// mid-update frame can yield a garbage ip; offsets are clamped here and
+// the report never dereferences beyond the owning chunk.
+static void site_record(ObjFunction* function, int offset)
+{
+    uint32_t index = (uint32_t)(((uintptr_t)function >> 4) * 31u + offset) &
+                     (PROFILE_SITE_SLOTS - 1);
+
+    for (int probe = 0; probe < PROFILE_SITE_SLOTS; ++probe)
+    {
+        SiteSample* site = &sites[index];
+
+        if (site->function == function && site->offset == offset)
+        {
+            site->count++;
+            return;
+        }
+
+        if (site->function == NULL)
+        {
+            site->function = function;
+            site->offset = offset;
+            site->count = 1;
+            return;
+        }
+
+        index = (index + 1) & (PROFILE_SITE_SLOTS - 1);
+    }
+
+    sample_dropped++;
+}
+
+static void fn_record(ObjFunction* function)
+{
+    uint32_t index =
+        (uint32_t)(((uintptr_t)function >> 4) * 31u) & (PROFILE_FN_SLOTS - 1);
+
+    for (int probe = 0; probe < PROFILE_FN_SLOTS; ++probe)
+    {
+        FnSample* fn = &fns[index];
+
+        if (fn->function == function)
+        {
+            fn->count++;
+            return;
+        }
+
+        if (fn->function == NULL)
+        {
+            fn->function = function;
+            fn->count = 1;
+            return;
+        }
+
+        index = (index + 1) & (PROFILE_FN_SLOTS - 1);
+    }
+}
+
+static void profile_handle_signal(int signal_number)
+{
+    (void)signal_number;
+
+    // The kernel may deliver SIGPROF on any thread; only the one that
+    // started the profiler owns the tables (and its functions are the
+    // ones still alive at report time).
+    if (!profile_active || !pthread_equal(pthread_self(), profile_thread))
+        return;
+
+    int frame_count = vm.frame_count;
+    if (frame_count <= 0 || frame_count > FRAMES_MAX) return;
+
+    sample_total++;
+
+    CallFrame* frame = &vm.frames[frame_count - 1];
+    ObjFunction* function = frame->closure->function;
+
+    int offset = (int)(frame->ip - function->chunk.code) - 1;
+    if (offset < 0) offset = 0;
+    if (offset >= function->chunk.count) offset = function->chunk.count - 1;
+
+    site_record(function, offset);
+
+    for (int i = 0; i < frame_count; ++i)
+    {
+        ObjFunction* on_stack = vm.frames[i].closure->function;
+
+        // Count recursive functions once per sample.
+        bool seen = false;
+        for (int j = 0; j < i; ++j)
+        {
+            if (vm.frames[j].closure->function == on_stack)
+            {
+                seen = true;
+                break;
+            }
+        }
+
+        if (!seen) fn_record(on_stack);
+    }
+}
+
+// Samples capture `frame->ip` after its operand reads, so raw offsets can
+// land inside an instruction; walk the chunk to the containing
+// instruction's start before attributing anything.
+static int site_align(Chunk* chunk, int offset)
+{
+    int aligned = 0;
+
+    while (aligned < chunk->count)
+    {
+        int next = aligned + chunk_instruction_length(chunk, aligned);
+        if (next > offset) break;
+        aligned = next;
+    }
+
+    return aligned;
+}
+
+static const char* function_name(ObjFunction* function)
+{
+    return function->name != NULL ? function->name->chars : "<Main Body>";
+}
+
+static int site_compare(const void* a, const void* b)
+{
+    const SiteSample* sa = a;
+    const SiteSample* sb = b;
+
+    if (sa->count != sb->count) return sa->count < sb->count ? 1 : -1;
+    return 0;
+}
+
+static int fn_compare(const void* a, const void* b)
+{
+    const FnSample* fa = a;
+    const FnSample* fb = b;
+
+    if (fa->count != fb->count) return fa->count < fb->count ? 1 : -1;
+    return 0;
+}
+
+static void profile_report()
+{
+    printf("== profile: %llu samples at %d Hz",
+           (unsigned long long)sample_total, profile_hz);
+    if (sample_dropped > 0)
+        printf(" (%llu dropped)", (unsigned long long)sample_dropped);
+    puts("");
+
+    if (sample_total == 0) return;
+
+    // Collapse per-offset samples onto source lines. The scratch array is
+    // at most as large as the site table, so plain linear merging is fine
+    // at report time.
+    static SiteSample lines[PROFILE_SITE_SLOTS];
+    int line_count = 0;
+
+    static SiteSample hot_sites[PROFILE_SITE_SLOTS];
+    int hot_count = 0;
+
+    for (int i = 0; i < PROFILE_SITE_SLOTS; ++i)
+    {
+        SiteSample* site = &sites[i];
+        if (site->function == NULL) continue;
+
+        int aligned = site_align(&site->function->chunk, site->offset);
+
+        int hot_found = -1;
+        for (int j = 0; j < hot_count; ++j)
+        {
+            if (hot_sites[j].function == site->function &&
+                hot_sites[j].offset == aligned)
+            {
+                hot_found = j;
+                break;
+            }
+        }
+
+        if (hot_found == -1)
+        {
+            hot_sites[hot_count].function = site->function;
+            hot_sites[hot_count].offset = aligned;
+            hot_sites[hot_count].count = site->count;
+            hot_count++;
+        }
+        else
+        {
+            hot_sites[hot_found].count += site->count;
+        }
+
+        int line = chunk_get_line(&site->function->chunk, aligned);
+        int found = -1;
+
+        for (int j = 0; j < line_count; ++j)
+        {
+            if (lines[j].function == site->function &&
+                lines[j].offset == line)
+            {
+                found = j;
+                break;
+            }
+        }
+
+        if (found == -1)
+        {
+            lines[line_count].function = site->function;
+            lines[line_count].offset = line; // Repurposed as the line.
+            lines[line_count].count = site->count;
+            line_count++;
+        }
+        else
+        {
+            lines[found].count += site->count;
+        }
+    }
+
+    qsort(lines, line_count, sizeof(SiteSample), site_compare);
+    qsort(hot_sites, hot_count, sizeof(SiteSample), site_compare);
+
+    printf("-- self time by line\n");
+    int shown = line_count < PROFILE_REPORT_LINES ? line_count
+                                                  : PROFILE_REPORT_LINES;
+    for (int i = 0; i < shown; ++i)
+    {
+        printf("%8llu %5.1f%%  %s:%d\n", (unsigned long long)lines[i].count,
+               100.0 * lines[i].count / sample_total,
+               function_name(lines[i].function), lines[i].offset);
+    }
+
+    printf("-- hottest bytecode\n");
+    shown = hot_count < PROFILE_REPORT_SITES ? hot_count
+                                             : PROFILE_REPORT_SITES;
+    for (int i = 0; i < shown; ++i)
+    {
+        printf("%8llu %5.1f%%  %s ", (unsigned long long)hot_sites[i].count,
+               100.0 * hot_sites[i].count / sample_total,
+               function_name(hot_sites[i].function));
+        instruction_disassemble(&hot_sites[i].function->chunk,
+                                hot_sites[i].offset);
+    }
+
+    printf("-- on-stack time by function\n");
+    static FnSample on_stack[PROFILE_FN_SLOTS];
+    int fn_count = 0;
+
+    for (int i = 0; i < PROFILE_FN_SLOTS; ++i)
+        if (fns[i].function != NULL) on_stack[fn_count++] = fns[i];
+
+    qsort(on_stack, fn_count, sizeof(FnSample), fn_compare);
+
+    for (int i = 0; i < fn_count; ++i)
+    {
+        printf("%8llu %5.1f%%  %s\n", (unsigned long long)on_stack[i].count,
+               100.0 * on_stack[i].count / sample_total,
+               function_name(on_stack[i].function));
+    }
+}
+
+static Value native_fn_profile_start(int argc, Value* args)
+{
+    if (profile_active)
+    {
+        raise_runtime_error("profiler is already running.");
+        return value_make_nil();
+    }
+
+    int hz = PROFILE_DEFAULT_HZ;
+    if (argc == 1 && value_is_number(args[0]))
+        hz = (int)value_as_number(args[0]);
+
+    if (hz < 1 || hz > 10000)
+    {
+        raise_runtime_error("profile rate must be between 1 and 10000 Hz.");
+        return value_make_nil();
+    }
+
+    memset(sites, 0, sizeof(sites));
+    memset(fns, 0, sizeof(fns));
+    sample_total = 0;
+    sample_dropped = 0;
+    profile_hz = hz;
+    profile_thread = pthread_self();
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = profile_handle_signal;
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &action, NULL);
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = 1000000 / hz;
+    timer.it_value = timer.it_interval;
+
+    profile_active = 1;
+    setitimer(ITIMER_PROF, &timer, NULL);
+
+    return value_make_nil();
+}
+
+static Value native_fn_profile_stop(int argc, Value* args)
+{
+    (void)argc;
+    (void)args;
+
+    if (!profile_active)
+    {
+        raise_runtime_error("profiler is not running.");
+        return value_make_nil();
+    }
+
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    profile_active = 0;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = SIG_DFL;
+    sigaction(SIGPROF, &action, NULL);
+
+    // Pending buffered output lands before the report.
+    vm_out_flush();
+    profile_report();
+
+    return value_make_nil();
+}
+
+void profiler_natives_define()
+{
+    vm_define_native_fn("profile_start", native_fn_profile_start);
+    vm_define_native_fn("profile_stop", native_fn_profile_stop);
+}
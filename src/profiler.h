@@ -0,0 +1,14 @@
+#ifndef CLOX_PROFILER_H_
+#define CLOX_PROFILER_H_
+
+// Sampling profiler: a CPU-time interval timer (SIGPROF) periodically
+// records the interpreter's current frame stack, and the report attributes
+// self time to source lines and on-stack time to functions. Sampling costs
+// nothing while stopped and low single-digit percent while running.
+//
+// Natives registered by profiler_natives_define():
+//   profile_start([hz]) -> begins sampling this thread (default 1000 Hz)
+//   profile_stop()      -> stops sampling and prints the report
+void profiler_natives_define();
+
+#endif // CLOX_PROFILER_H_
@@ -8,26 +8,49 @@ typedef struct
 {
     const char* start;
     const char* current;
+    // One past the last source byte; measured once at init so the batched
+    // skips below never have to re-check for the terminator byte by byte.
+    const char* end;
     int line;
 } Scanner;
 
-Scanner scanner;
+_Thread_local Scanner scanner;
+
+// Character classes looked up per byte, so identifier and number runs
+// advance on one table load instead of a chain of range compares.
+#define SCAN_ALPHA 0x01
+#define SCAN_DIGIT 0x02
+
+static uint8_t char_class[256];
+
+static void char_class_init()
+{
+    if (char_class['a'] != 0) return;
+
+    for (int c = 'a'; c <= 'z'; ++c) char_class[c] = SCAN_ALPHA;
+    for (int c = 'A'; c <= 'Z'; ++c) char_class[c] = SCAN_ALPHA;
+    for (int c = '0'; c <= '9'; ++c) char_class[c] = SCAN_DIGIT;
+    char_class['_'] = SCAN_ALPHA;
+}
 
 void scanner_init(const char* source)
 {
+    char_class_init();
+
     scanner.start = source;
     scanner.current = source;
+    scanner.end = source + strlen(source);
     scanner.line = 1;
 }
 
 static bool is_alpha(char c)
 {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    return (char_class[(uint8_t)c] & SCAN_ALPHA) != 0;
 }
 
 static bool is_digit(char c)
 {
-    return c >= '0' && c <= '9';
+    return (char_class[(uint8_t)c] & SCAN_DIGIT) != 0;
 }
 
 static bool is_at_end()
@@ -83,10 +106,52 @@ static Token token_make_error(const char* message)
     return token;
 }
 
+// Word-at-a-time whitespace skipping in the spirit of the SWAR group scan
+// in src/table.c; the byte loop in skip_whitespaces() picks up the
+// stragglers and every other compiler.
+#if defined(__GNUC__) || defined(__clang__)
+#define SCANNER_USE_WORD_SKIP
+#endif
+
+#ifdef SCANNER_USE_WORD_SKIP
+// High bit of every byte in `word` equal to `byte` (the standard SWAR
+// zero-byte finder applied to the xor).
+static uint64_t word_match(uint64_t word, char byte)
+{
+    uint64_t diff = word ^ (UINT64_C(0x0101010101010101) * (uint8_t)byte);
+    return (diff - UINT64_C(0x0101010101010101)) & ~diff &
+           UINT64_C(0x8080808080808080);
+}
+#endif
+
+static void whitespace_skip_words()
+{
+#ifdef SCANNER_USE_WORD_SKIP
+    while (scanner.end - scanner.current >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, scanner.current, sizeof(word));
+
+        uint64_t newlines = word_match(word, '\n');
+        uint64_t spaces = word_match(word, ' ') | word_match(word, '\t') |
+                          word_match(word, '\r') | newlines;
+
+        // Only whole whitespace words are consumed here; a word holding
+        // the next token falls through to the byte loop.
+        if (spaces != UINT64_C(0x8080808080808080)) return;
+
+        scanner.line += __builtin_popcountll(newlines);
+        scanner.current += 8;
+    }
+#endif
+}
+
 static void skip_whitespaces()
 {
     while (true)
     {
+        whitespace_skip_words();
+
         char c = get_current_char();
 
         switch (c)
@@ -105,9 +170,12 @@ static void skip_whitespaces()
             case '/':
                 if (get_next_char() == '/')
                 {
-                    // A comment goes until the end of line
-                    while (get_current_char() != '\n' && !is_at_end())
-                        move_to_next_char();
+                    // A comment goes until the end of line; memchr skips
+                    // it in bulk.
+                    const char* newline =
+                        memchr(scanner.current, '\n',
+                               scanner.end - scanner.current);
+                    scanner.current = newline != NULL ? newline : scanner.end;
                 }
                 else
                     return;
@@ -207,8 +275,7 @@ static TokenType get_identifier_type()
 
 static Token token_make_identifier()
 {
-    while (is_alpha(get_current_char()) || is_digit(get_current_char()))
-        move_to_next_char();
+    while (char_class[(uint8_t)get_current_char()] != 0) move_to_next_char();
 
     return token_make(get_identifier_type());
 }
@@ -231,16 +298,24 @@ static Token token_make_number()
 
 static Token token_make_string()
 {
-    while (get_current_char() != '"' && !is_at_end())
+    // memchr finds the closing quote in bulk; a second pass over the body
+    // keeps the line counter honest.
+    const char* quote =
+        memchr(scanner.current, '"', scanner.end - scanner.current);
+    const char* body_end = quote != NULL ? quote : scanner.end;
+
+    for (const char* c = scanner.current;
+         (c = memchr(c, '\n', body_end - c)) != NULL; ++c)
+        scanner.line++;
+
+    if (quote == NULL)
     {
-        if (get_current_char() == '\n') scanner.line++;
-        move_to_next_char();
+        scanner.current = scanner.end;
+        return token_make_error("Unterminated string.");
     }
 
-    if (is_at_end()) return token_make_error("Unterminated string.");
-
     // The closing quote.
-    move_to_next_char();
+    scanner.current = quote + 1;
     return token_make(TOKEN_STRING);
 }
 
@@ -0,0 +1,1266 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+#include "object.h"
+#include "serialize.h"
+#include "table.h"
+#include "vm.h"
+
+// Binary .loxc layout (native endianness, meant for same-machine reuse):
+//   u32 magic, u8 version,
+//   u32 global-name count, then each name in slot order (u32 length + bytes),
+//   then the root function record; functions nest through their constants.
+//
+// The global-name list pins the slot indices baked into the bytecode: the
+// loader replays the names through vm_global_slot and refuses the file when
+// a name does not land on its recorded slot.
+
+#define LOXC_MAGIC 0x43584F4Cu // "LOXC"
+#define LOXC_VERSION 4 // Bumped for the map opcodes renumbering the rest.
+
+typedef enum
+{
+    SER_NIL,
+    SER_FALSE,
+    SER_TRUE,
+    SER_NUMBER,
+    SER_STRING,
+    SER_FUNCTION,
+    // Snapshot-only tags: an object reference by image id, and a global
+    // slot the restore leaves untouched (natives, undefined slots).
+    SER_OBJ,
+    SER_KEEP,
+} SerializedTag;
+
+///////////////////////////////////////////////////////////////////////////////////////
+// WRITING
+///////////////////////////////////////////////////////////////////////////////////////
+
+static bool u8_write(FILE* out, uint8_t value)
+{
+    return fwrite(&value, sizeof(value), 1, out) == 1;
+}
+
+static bool u32_write(FILE* out, uint32_t value)
+{
+    return fwrite(&value, sizeof(value), 1, out) == 1;
+}
+
+static bool f64_write(FILE* out, double value)
+{
+    return fwrite(&value, sizeof(value), 1, out) == 1;
+}
+
+static bool string_write(FILE* out, ObjString* string)
+{
+    if (!u32_write(out, (uint32_t)string->length)) return false;
+
+    return string->length == 0 ||
+           fwrite(string->chars, sizeof(char), string->length, out) ==
+               (size_t)string->length;
+}
+
+static bool function_write(FILE* out, ObjFunction* function);
+
+static bool constant_write(FILE* out, Value value)
+{
+    if (value_is_nil(value)) return u8_write(out, SER_NIL);
+
+    if (value_is_bool(value))
+        return u8_write(out, value_as_bool(value) ? SER_TRUE : SER_FALSE);
+
+    if (value_is_number(value))
+        return u8_write(out, SER_NUMBER) &&
+               f64_write(out, value_as_number(value));
+
+    if (obj_is_string(value))
+        return u8_write(out, SER_STRING) &&
+               string_write(out, obj_as_string(value));
+
+    if (obj_is_function(value))
+        return u8_write(out, SER_FUNCTION) &&
+               function_write(out, obj_as_function(value));
+
+    // Only compile-time constants ever reach a chunk's constant table.
+    return false;
+}
+
+static bool function_write(FILE* out, ObjFunction* function)
+{
+    if (!u8_write(out, function->name != NULL)) return false;
+    if (function->name != NULL && !string_write(out, function->name))
+        return false;
+
+    if (!u32_write(out, (uint32_t)function->arity)) return false;
+    if (!u32_write(out, (uint32_t)function->upvalue_count)) return false;
+
+    Chunk* chunk = &function->chunk;
+    if (!u32_write(out, (uint32_t)chunk->count)) return false;
+
+    if (chunk->count > 0 &&
+        fwrite(chunk->code, sizeof(uint8_t), chunk->count, out) !=
+            (size_t)chunk->count)
+        return false;
+
+    if (!u32_write(out, (uint32_t)chunk->line_count)) return false;
+
+    for (int i = 0; i < chunk->line_count; ++i)
+    {
+        if (!u32_write(out, (uint32_t)chunk->lines[i].offset)) return false;
+        if (!u32_write(out, (uint32_t)chunk->lines[i].line)) return false;
+    }
+
+    if (!u32_write(out, (uint32_t)chunk->constants.count)) return false;
+
+    for (int i = 0; i < chunk->constants.count; ++i)
+        if (!constant_write(out, chunk->constants.values[i])) return false;
+
+    return true;
+}
+
+static bool globals_write(FILE* out)
+{
+    int count = vm.global_slots.count;
+    if (!u32_write(out, (uint32_t)count)) return false;
+
+    for (int slot = 0; slot < count; ++slot)
+    {
+        ObjString* name = NULL;
+
+        for (int i = 0; i < vm.global_names.capacity; ++i)
+        {
+            Entry* entry = &vm.global_names.entries[i];
+
+            if (entry->key != NULL &&
+                (int)value_as_number(entry->value) == slot)
+            {
+                name = entry->key;
+                break;
+            }
+        }
+
+        if (name == NULL || !string_write(out, name)) return false;
+    }
+
+    return true;
+}
+
+bool serialize_function_write(ObjFunction* function, const char* path)
+{
+    FILE* out = fopen(path, "wb");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Could not open file '%s' for writing.\n", path);
+        return false;
+    }
+
+    bool ok = u32_write(out, LOXC_MAGIC) && u8_write(out, LOXC_VERSION) &&
+              globals_write(out) && function_write(out, function);
+
+    if (fclose(out) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Could not write bytecode to '%s'.\n", path);
+
+    return ok;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// READING
+///////////////////////////////////////////////////////////////////////////////////////
+
+static bool u8_read(FILE* in, uint8_t* out_value)
+{
+    return fread(out_value, sizeof(*out_value), 1, in) == 1;
+}
+
+static bool u32_read(FILE* in, uint32_t* out_value)
+{
+    return fread(out_value, sizeof(*out_value), 1, in) == 1;
+}
+
+static bool f64_read(FILE* in, double* out_value)
+{
+    return fread(out_value, sizeof(*out_value), 1, in) == 1;
+}
+
+// Reads a length-prefixed string and interns it; interning keeps the result
+// rooted through vm.strings exactly like compiled string constants.
+static ObjString* string_read(FILE* in)
+{
+    uint32_t length;
+    if (!u32_read(in, &length) || length > INT32_MAX) return NULL;
+
+    char* chars = mem_alloc(char, length + 1);
+    if (length > 0 && fread(chars, sizeof(char), length, in) != length)
+    {
+        array_free(char, chars, length + 1);
+        return NULL;
+    }
+
+    chars[length] = '\0';
+    return obj_string_take(chars, (int)length);
+}
+
+static ObjFunction* function_read(FILE* in);
+
+static bool constant_read(FILE* in, Value* out_value)
+{
+    uint8_t tag;
+    if (!u8_read(in, &tag)) return false;
+
+    switch (tag)
+    {
+        case SER_NIL:
+            *out_value = value_make_nil();
+            return true;
+
+        case SER_FALSE:
+            *out_value = value_make_bool(false);
+            return true;
+
+        case SER_TRUE:
+            *out_value = value_make_bool(true);
+            return true;
+
+        case SER_NUMBER:
+        {
+            double number;
+            if (!f64_read(in, &number)) return false;
+
+            *out_value = value_make_number(number);
+            return true;
+        }
+
+        case SER_STRING:
+        {
+            ObjString* string = string_read(in);
+            if (string == NULL) return false;
+
+            *out_value = value_make_obj(string);
+            return true;
+        }
+
+        case SER_FUNCTION:
+        {
+            ObjFunction* function = function_read(in);
+            if (function == NULL) return false;
+
+            *out_value = value_make_obj(function);
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+static ObjFunction* function_read(FILE* in)
+{
+    ObjFunction* function = obj_function_new();
+
+    // Keep the half-built function rooted; the reads below allocate and can
+    // trigger a collection.
+    vm_stack_push(value_make_obj(function));
+
+    uint8_t has_name;
+    if (!u8_read(in, &has_name)) goto fail;
+
+    if (has_name)
+    {
+        function->name = string_read(in);
+        if (function->name == NULL) goto fail;
+        gc_barrier_obj((Obj*)function->name);
+    }
+
+    uint32_t arity, upvalue_count, code_count;
+    if (!u32_read(in, &arity) || !u32_read(in, &upvalue_count) ||
+        !u32_read(in, &code_count) || code_count > INT32_MAX)
+        goto fail;
+
+    function->arity = (int)arity;
+    function->upvalue_count = (int)upvalue_count;
+
+    Chunk* chunk = &function->chunk;
+    if (code_count > 0)
+    {
+        chunk->code = array_grow(uint8_t, NULL, 0, code_count);
+        chunk->capacity = (int)code_count;
+        chunk->count = (int)code_count;
+
+        if (fread(chunk->code, sizeof(uint8_t), code_count, in) != code_count)
+            goto fail;
+    }
+
+    uint32_t line_count;
+    if (!u32_read(in, &line_count) || line_count > code_count) goto fail;
+
+    if (line_count > 0)
+    {
+        chunk->lines = array_grow(LineStart, NULL, 0, line_count);
+        chunk->line_capacity = (int)line_count;
+        chunk->line_count = (int)line_count;
+
+        for (uint32_t i = 0; i < line_count; ++i)
+        {
+            uint32_t offset;
+            uint32_t line;
+            if (!u32_read(in, &offset) || !u32_read(in, &line)) goto fail;
+
+            chunk->lines[i].offset = (int)offset;
+            chunk->lines[i].line = (int)line;
+        }
+    }
+
+    uint32_t constant_count;
+    if (!u32_read(in, &constant_count) || constant_count > INT32_MAX)
+        goto fail;
+
+    for (uint32_t i = 0; i < constant_count; ++i)
+    {
+        Value constant;
+        if (!constant_read(in, &constant)) goto fail;
+
+        // Append directly: chunk_constant_add() dedupes, and renumbering a
+        // loaded pool would break the indices baked into the bytecode.
+        vm_stack_push(constant);
+        value_array_write(&chunk->constants, constant);
+        vm_stack_pop();
+    }
+
+    vm_stack_pop();
+    return function;
+
+fail:
+    vm_stack_pop();
+    return NULL;
+}
+
+// Replays the recorded global names so every slot index baked into the
+// bytecode points at the same global it did at compile time.
+static bool globals_read(FILE* in)
+{
+    uint32_t count;
+    if (!u32_read(in, &count) || count > INT32_MAX) return false;
+
+    for (uint32_t slot = 0; slot < count; ++slot)
+    {
+        ObjString* name = string_read(in);
+        if (name == NULL) return false;
+
+        if (vm_global_slot(name) != (int)slot)
+        {
+            fprintf(stderr,
+                    "Global '%s' does not match its recorded slot; "
+                    "recompile the .loxc file.\n",
+                    name->chars);
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+ObjFunction* serialize_function_read(const char* path)
+{
+    FILE* in = fopen(path, "rb");
+    if (in == NULL)
+    {
+        fprintf(stderr, "Could not open file '%s'.\n", path);
+        return NULL;
+    }
+
+    uint32_t magic;
+    uint8_t version;
+    ObjFunction* function = NULL;
+
+    if (!u32_read(in, &magic) || magic != LOXC_MAGIC ||
+        !u8_read(in, &version) || version != LOXC_VERSION)
+    {
+        fprintf(stderr, "'%s' is not a compatible .loxc file.\n", path);
+    }
+    else if (globals_read(in))
+    {
+        function = function_read(in);
+
+        if (function == NULL)
+            fprintf(stderr, "Could not read bytecode from '%s'.\n", path);
+    }
+
+    fclose(in);
+    return function;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////
+// HEAP SNAPSHOTS
+///////////////////////////////////////////////////////////////////////////////////////
+
+// A .snap image captures the warmed state a prelude script left behind:
+// every object reachable from the global slots, plus the global name ->
+// slot mapping itself. Restoring replays the image into a freshly
+// vm_init()ed VM in one linear read, skipping the prelude's compile and
+// execution entirely.
+//
+// Layout: u32 magic, u8 version, u32 object count, then two passes over
+// the objects in id order — an allocation record per object, then a fill
+// record patching the references — then the global slots. Ids are
+// assigned so that anything needed at allocation time (a closure's
+// function, a class's name, an instance's class) always has a smaller id
+// than its owner; cycles are confined to the fill pass. Function records
+// reuse the self-contained .loxc blobs, so a function nested in another
+// function's constants is restored as its own copy — identical code,
+// shared nothing.
+//
+// Native function objects never enter an image (their pointers die with
+// the process): a global slot holding one writes a KEEP record instead,
+// leaving whatever the restoring VM's own registration put there. A
+// native reachable anywhere else fails the snapshot, as does an open
+// upvalue, whose value still lives on some stack.
+
+#define SNAP_MAGIC 0x53584F4Cu // "LOXS"
+#define SNAP_VERSION 2
+
+typedef enum
+{
+    SNAP_STRING,
+    SNAP_FUNCTION,
+    SNAP_UPVALUE,
+    SNAP_CLOSURE,
+    SNAP_CLASS,
+    SNAP_INSTANCE,
+    SNAP_LIST,
+    SNAP_MAP,
+    SNAP_BOUND_METHOD,
+    SNAP_TYPE_COUNT,
+} SnapType;
+
+// Allocation-order rank; smaller ranks get smaller ids.
+static int snap_type_of(Obj* object)
+{
+    switch (object->type)
+    {
+        case OBJ_STRING: return SNAP_STRING;
+        case OBJ_FUNCTION: return SNAP_FUNCTION;
+        case OBJ_UPVALUE: return SNAP_UPVALUE;
+        case OBJ_CLOSURE: return SNAP_CLOSURE;
+        case OBJ_CLASS: return SNAP_CLASS;
+        case OBJ_INSTANCE: return SNAP_INSTANCE;
+        case OBJ_LIST: return SNAP_LIST;
+        case OBJ_MAP: return SNAP_MAP;
+        case OBJ_BOUND_METHOD: return SNAP_BOUND_METHOD;
+        default: return -1;
+    }
+}
+
+// The writer's object set: discovery order in `objects`, with an open
+// addressing pointer map for the id lookups, and `final_ids` holding the
+// rank-sorted id each object ends up with in the image.
+typedef struct
+{
+    Obj** objects;
+    int count;
+    int capacity;
+
+    Obj** map_keys;
+    int* map_indexes;
+    int map_capacity;
+
+    int* final_ids;
+} SnapGraph;
+
+static bool graph_map_find(SnapGraph* graph, Obj* object, int* out_index)
+{
+    uint32_t mask = graph->map_capacity - 1;
+    uint32_t index = (uint32_t)(((uintptr_t)object >> 4) * 2654435761u) & mask;
+
+    while (graph->map_keys[index] != NULL)
+    {
+        if (graph->map_keys[index] == object)
+        {
+            *out_index = graph->map_indexes[index];
+            return true;
+        }
+
+        index = (index + 1) & mask;
+    }
+
+    *out_index = (int)index;
+    return false;
+}
+
+static void graph_map_grow(SnapGraph* graph)
+{
+    int old_capacity = graph->map_capacity;
+    Obj** old_keys = graph->map_keys;
+    int* old_indexes = graph->map_indexes;
+
+    graph->map_capacity = old_capacity < 64 ? 64 : old_capacity * 2;
+    graph->map_keys = calloc(graph->map_capacity, sizeof(Obj*));
+    graph->map_indexes = malloc(graph->map_capacity * sizeof(int));
+    if (graph->map_keys == NULL || graph->map_indexes == NULL) exit(74);
+
+    for (int i = 0; i < old_capacity; ++i)
+    {
+        if (old_keys[i] == NULL) continue;
+
+        int slot;
+        graph_map_find(graph, old_keys[i], &slot);
+        graph->map_keys[slot] = old_keys[i];
+        graph->map_indexes[slot] = old_indexes[i];
+    }
+
+    free(old_keys);
+    free(old_indexes);
+}
+
+// Adds `object` to the set; returns false when it was already present.
+static bool graph_add(SnapGraph* graph, Obj* object)
+{
+    if (graph->map_capacity == 0 ||
+        graph->count + 1 > graph->map_capacity / 2)
+        graph_map_grow(graph);
+
+    int slot;
+    if (graph_map_find(graph, object, &slot)) return false;
+
+    if (graph->count + 1 > graph->capacity)
+    {
+        graph->capacity = graph->capacity < 64 ? 64 : graph->capacity * 2;
+        graph->objects =
+            realloc(graph->objects, graph->capacity * sizeof(Obj*));
+        if (graph->objects == NULL) exit(74);
+    }
+
+    graph->map_keys[slot] = object;
+    graph->map_indexes[slot] = graph->count;
+    graph->objects[graph->count++] = object;
+    return true;
+}
+
+static bool graph_visit(SnapGraph* graph, Obj* object);
+
+static bool graph_visit_value(SnapGraph* graph, Value value)
+{
+    if (!value_is_obj(value)) return true;
+
+    return graph_visit(graph, value_as_obj(value));
+}
+
+static bool graph_visit_table(SnapGraph* graph, Table* table)
+{
+    for (int i = 0; i < table->capacity; ++i)
+    {
+        Entry* entry = &table->entries[i];
+        if (entry->key == NULL) continue;
+
+        if (!graph_visit(graph, (Obj*)entry->key)) return false;
+        if (!graph_visit_value(graph, entry->value)) return false;
+    }
+
+    return true;
+}
+
+static bool graph_visit(SnapGraph* graph, Obj* object)
+{
+    if (object == NULL) return true;
+    if (!graph_add(graph, object)) return true;
+
+    switch (object->type)
+    {
+        case OBJ_STRING:
+        case OBJ_FUNCTION:
+            // Self-contained records; functions carry their whole constant
+            // tree in the .loxc blob.
+            return true;
+
+        case OBJ_UPVALUE:
+        {
+            ObjUpValue* upvalue = (ObjUpValue*)object;
+            if (upvalue->location != &upvalue->closed)
+            {
+                fprintf(stderr,
+                        "Snapshot cannot capture an open upvalue.\n");
+                return false;
+            }
+
+            return graph_visit_value(graph, upvalue->closed);
+        }
+
+        case OBJ_CLOSURE:
+        {
+            ObjClosure* closure = (ObjClosure*)object;
+            if (!graph_visit(graph, (Obj*)closure->function)) return false;
+
+            for (int i = 0; i < closure->upvalue_count; ++i)
+                if (!graph_visit(graph, (Obj*)closure->upvalues[i]))
+                    return false;
+
+            return true;
+        }
+
+        case OBJ_CLASS:
+        {
+            ObjClass* cls = (ObjClass*)object;
+            if (!graph_visit(graph, (Obj*)cls->name)) return false;
+
+            return graph_visit_table(graph, &cls->methods);
+        }
+
+        case OBJ_INSTANCE:
+        {
+            ObjInstance* instance = (ObjInstance*)object;
+            if (!graph_visit(graph, (Obj*)instance->cls)) return false;
+
+            return graph_visit_table(graph, &instance->fields);
+        }
+
+        case OBJ_LIST:
+        {
+            ObjList* list = (ObjList*)object;
+            if (list->is_numeric) return true;
+
+            for (int i = 0; i < list->count; ++i)
+                if (!graph_visit_value(graph, list->items[i])) return false;
+
+            return true;
+        }
+
+        case OBJ_MAP:
+            return graph_visit_table(graph, &((ObjMap*)object)->table);
+
+        case OBJ_BOUND_METHOD:
+        {
+            ObjBoundMethod* bound = (ObjBoundMethod*)object;
+            if (!graph_visit_value(graph, bound->receiver)) return false;
+
+            return graph_visit(graph, (Obj*)bound->method);
+        }
+
+        default:
+            fprintf(stderr,
+                    "Snapshot cannot capture a native function outside a "
+                    "global slot.\n");
+            return false;
+    }
+}
+
+static int snap_id(SnapGraph* graph, Obj* object)
+{
+    int index;
+    graph_map_find(graph, object, &index);
+    return graph->final_ids[index == -1 ? 0 : index];
+}
+
+static bool snap_value_write(FILE* out, SnapGraph* graph, Value value)
+{
+    if (value_is_nil(value)) return u8_write(out, SER_NIL);
+
+    if (value_is_bool(value))
+        return u8_write(out, value_as_bool(value) ? SER_TRUE : SER_FALSE);
+
+    if (value_is_number(value))
+        return u8_write(out, SER_NUMBER) &&
+               f64_write(out, value_as_number(value));
+
+    return u8_write(out, SER_OBJ) &&
+           u32_write(out, (uint32_t)snap_id(graph, value_as_obj(value)));
+}
+
+static bool snap_alloc_write(FILE* out, SnapGraph* graph, Obj* object)
+{
+    int type = snap_type_of(object);
+    if (!u8_write(out, (uint8_t)type)) return false;
+
+    switch (type)
+    {
+        case SNAP_STRING:
+        {
+            ObjString* string = (ObjString*)object;
+            obj_string_chars(string); // Flatten a rope before writing.
+            return string_write(out, string);
+        }
+
+        case SNAP_FUNCTION:
+            return function_write(out, (ObjFunction*)object);
+
+        case SNAP_UPVALUE:
+            return true;
+
+        case SNAP_CLOSURE:
+        {
+            ObjClosure* closure = (ObjClosure*)object;
+            return u32_write(
+                out, (uint32_t)snap_id(graph, (Obj*)closure->function));
+        }
+
+        case SNAP_CLASS:
+        {
+            ObjClass* cls = (ObjClass*)object;
+            return u32_write(out, (uint32_t)snap_id(graph, (Obj*)cls->name));
+        }
+
+        case SNAP_INSTANCE:
+        {
+            ObjInstance* instance = (ObjInstance*)object;
+            return u32_write(out,
+                             (uint32_t)snap_id(graph, (Obj*)instance->cls));
+        }
+
+        case SNAP_LIST:
+        {
+            ObjList* list = (ObjList*)object;
+            if (!u8_write(out, list->is_numeric)) return false;
+            if (!u32_write(out, (uint32_t)list->count)) return false;
+
+            return !list->is_numeric || list->count == 0 ||
+                   fwrite(list->numbers, sizeof(double), list->count, out) ==
+                       (size_t)list->count;
+        }
+
+        case SNAP_MAP:
+            return u32_write(out,
+                             (uint32_t)((ObjMap*)object)->table.count);
+
+        case SNAP_BOUND_METHOD:
+        {
+            ObjBoundMethod* bound = (ObjBoundMethod*)object;
+            return u32_write(out,
+                             (uint32_t)snap_id(graph, (Obj*)bound->method));
+        }
+
+        default:
+            return false;
+    }
+}
+
+static bool snap_fill_write(FILE* out, SnapGraph* graph, Obj* object)
+{
+    switch (snap_type_of(object))
+    {
+        case SNAP_UPVALUE:
+            return snap_value_write(out, graph,
+                                    ((ObjUpValue*)object)->closed);
+
+        case SNAP_CLOSURE:
+        {
+            ObjClosure* closure = (ObjClosure*)object;
+
+            for (int i = 0; i < closure->upvalue_count; ++i)
+                if (!u32_write(out, (uint32_t)snap_id(
+                                        graph, (Obj*)closure->upvalues[i])))
+                    return false;
+
+            return true;
+        }
+
+        case SNAP_CLASS:
+        {
+            Table* methods = &((ObjClass*)object)->methods;
+            if (!u32_write(out, (uint32_t)methods->count)) return false;
+
+            for (int i = 0; i < methods->capacity; ++i)
+            {
+                Entry* entry = &methods->entries[i];
+                if (entry->key == NULL) continue;
+
+                if (!u32_write(out,
+                               (uint32_t)snap_id(graph, (Obj*)entry->key)))
+                    return false;
+                if (!snap_value_write(out, graph, entry->value)) return false;
+            }
+
+            return true;
+        }
+
+        case SNAP_INSTANCE:
+        {
+            Table* fields = &((ObjInstance*)object)->fields;
+            if (!u32_write(out, (uint32_t)fields->count)) return false;
+
+            for (int i = 0; i < fields->capacity; ++i)
+            {
+                Entry* entry = &fields->entries[i];
+                if (entry->key == NULL) continue;
+
+                if (!u32_write(out,
+                               (uint32_t)snap_id(graph, (Obj*)entry->key)))
+                    return false;
+                if (!snap_value_write(out, graph, entry->value)) return false;
+            }
+
+            return true;
+        }
+
+        case SNAP_LIST:
+        {
+            ObjList* list = (ObjList*)object;
+            if (list->is_numeric) return true;
+
+            for (int i = 0; i < list->count; ++i)
+                if (!snap_value_write(out, graph, list->items[i]))
+                    return false;
+
+            return true;
+        }
+
+        case SNAP_MAP:
+        {
+            Table* table = &((ObjMap*)object)->table;
+            if (!u32_write(out, (uint32_t)table->count)) return false;
+
+            for (int i = 0; i < table->capacity; ++i)
+            {
+                Entry* entry = &table->entries[i];
+                if (entry->key == NULL) continue;
+
+                if (!u32_write(out,
+                               (uint32_t)snap_id(graph, (Obj*)entry->key)))
+                    return false;
+                if (!snap_value_write(out, graph, entry->value)) return false;
+            }
+
+            return true;
+        }
+
+        case SNAP_BOUND_METHOD:
+            return snap_value_write(out, graph,
+                                    ((ObjBoundMethod*)object)->receiver);
+
+        default:
+            return true;
+    }
+}
+
+bool serialize_snapshot_write(const char* path)
+{
+    SnapGraph graph;
+    memset(&graph, 0, sizeof(graph));
+
+    bool ok = true;
+
+    // Collect everything reachable from the globals, names included.
+    for (int slot = 0; ok && slot < vm.global_slots.count; ++slot)
+    {
+        Value value = vm.global_slots.values[slot];
+        if (value_is_undefined(value) || obj_is_native_fn(value)) continue;
+
+        ok = graph_visit_value(&graph, value);
+    }
+
+    for (int i = 0; ok && i < vm.global_names.capacity; ++i)
+    {
+        Entry* entry = &vm.global_names.entries[i];
+        if (entry->key != NULL) ok = graph_visit(&graph, (Obj*)entry->key);
+    }
+
+    // Stable rank sort: ids count up through the types in allocation
+    // order, so every allocation-time reference points backward.
+    int* order = NULL;
+    if (ok)
+    {
+        graph.final_ids = malloc(graph.count * sizeof(int));
+        order = malloc(graph.count * sizeof(int));
+        if (graph.final_ids == NULL || order == NULL) exit(74);
+
+        int next_id = 0;
+        for (int rank = 0; rank < SNAP_TYPE_COUNT; ++rank)
+        {
+            for (int i = 0; i < graph.count; ++i)
+            {
+                if (snap_type_of(graph.objects[i]) != rank) continue;
+
+                int slot;
+                graph_map_find(&graph, graph.objects[i], &slot);
+                graph.final_ids[slot] = next_id;
+                order[next_id++] = i;
+            }
+        }
+    }
+
+    FILE* out = NULL;
+    if (ok)
+    {
+        out = fopen(path, "wb");
+        if (out == NULL)
+        {
+            fprintf(stderr, "Could not open file '%s' for writing.\n", path);
+            ok = false;
+        }
+    }
+
+    ok = ok && u32_write(out, SNAP_MAGIC) && u8_write(out, SNAP_VERSION) &&
+         u32_write(out, (uint32_t)graph.count);
+
+    for (int i = 0; ok && i < graph.count; ++i)
+        ok = snap_alloc_write(out, &graph, graph.objects[order[i]]);
+
+    for (int i = 0; ok && i < graph.count; ++i)
+        ok = snap_fill_write(out, &graph, graph.objects[order[i]]);
+
+    // The global slots in slot order, so the restore replays the exact
+    // same name -> slot assignment the prelude produced.
+    ok = ok && u32_write(out, (uint32_t)vm.global_slots.count);
+
+    for (int slot = 0; ok && slot < vm.global_slots.count; ++slot)
+    {
+        ObjString* name = NULL;
+
+        for (int i = 0; i < vm.global_names.capacity; ++i)
+        {
+            Entry* entry = &vm.global_names.entries[i];
+
+            if (entry->key != NULL &&
+                (int)value_as_number(entry->value) == slot)
+            {
+                name = entry->key;
+                break;
+            }
+        }
+
+        ok = name != NULL &&
+             u32_write(out, (uint32_t)snap_id(&graph, (Obj*)name));
+
+        Value value = vm.global_slots.values[slot];
+        if (ok)
+        {
+            if (value_is_undefined(value) || obj_is_native_fn(value))
+                ok = u8_write(out, SER_KEEP);
+            else
+                ok = snap_value_write(out, &graph, value);
+        }
+    }
+
+    if (out != NULL && fclose(out) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Could not write snapshot to '%s'.\n", path);
+
+    free(graph.objects);
+    free(graph.map_keys);
+    free(graph.map_indexes);
+    free(graph.final_ids);
+    free(order);
+
+    return ok;
+}
+
+// Resolves an already-allocated object id during the restore.
+static Obj* snap_ref_read(FILE* in, Obj** objects, uint32_t limit)
+{
+    uint32_t id;
+    if (!u32_read(in, &id) || id >= limit) return NULL;
+
+    return objects[id];
+}
+
+static bool snap_value_read(FILE* in, Obj** objects, uint32_t count,
+                            Value* out_value)
+{
+    uint8_t tag;
+    if (!u8_read(in, &tag)) return false;
+
+    switch (tag)
+    {
+        case SER_NIL:
+            *out_value = value_make_nil();
+            return true;
+
+        case SER_FALSE:
+            *out_value = value_make_bool(false);
+            return true;
+
+        case SER_TRUE:
+            *out_value = value_make_bool(true);
+            return true;
+
+        case SER_NUMBER:
+        {
+            double number;
+            if (!f64_read(in, &number)) return false;
+
+            *out_value = value_make_number(number);
+            return true;
+        }
+
+        case SER_OBJ:
+        {
+            Obj* object = snap_ref_read(in, objects, count);
+            if (object == NULL) return false;
+
+            *out_value = value_make_obj(object);
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+static bool snap_restore(FILE* in)
+{
+    uint32_t count;
+    if (!u32_read(in, &count) || count > INT32_MAX) return false;
+
+    Obj** objects = calloc(count > 0 ? count : 1, sizeof(Obj*));
+    uint8_t* types = malloc(count > 0 ? count : 1);
+    // Boxed-list item counts; restored lists start numeric either way, so
+    // the writer's representation can't be read back off the object.
+    uint32_t* list_counts = calloc(count > 0 ? count : 1, sizeof(uint32_t));
+    if (objects == NULL || types == NULL || list_counts == NULL) exit(74);
+
+    bool ok = true;
+
+    // Allocation pass: every record only refers to smaller ids.
+    for (uint32_t i = 0; ok && i < count; ++i)
+    {
+        uint8_t type;
+        ok = u8_read(in, &type) && type < SNAP_TYPE_COUNT;
+        if (!ok) break;
+
+        types[i] = type;
+
+        switch (type)
+        {
+            case SNAP_STRING:
+                objects[i] = (Obj*)string_read(in);
+                break;
+
+            case SNAP_FUNCTION:
+                objects[i] = (Obj*)function_read(in);
+                break;
+
+            case SNAP_UPVALUE:
+            {
+                ObjUpValue* upvalue = obj_upvalue_new(NULL);
+                upvalue->closed = value_make_nil();
+                upvalue->location = &upvalue->closed;
+                objects[i] = (Obj*)upvalue;
+                break;
+            }
+
+            case SNAP_CLOSURE:
+            {
+                Obj* function = snap_ref_read(in, objects, i);
+                ok = function != NULL && function->type == OBJ_FUNCTION;
+                if (ok)
+                    objects[i] =
+                        (Obj*)obj_closure_new((ObjFunction*)function);
+                break;
+            }
+
+            case SNAP_CLASS:
+            {
+                Obj* name = snap_ref_read(in, objects, i);
+                ok = name != NULL && name->type == OBJ_STRING;
+                if (ok) objects[i] = (Obj*)obj_class_new((ObjString*)name);
+                break;
+            }
+
+            case SNAP_INSTANCE:
+            {
+                Obj* cls = snap_ref_read(in, objects, i);
+                ok = cls != NULL && cls->type == OBJ_CLASS;
+                if (ok) objects[i] = (Obj*)obj_instance_new((ObjClass*)cls);
+                break;
+            }
+
+            case SNAP_LIST:
+            {
+                uint8_t is_numeric;
+                uint32_t item_count;
+                ok = u8_read(in, &is_numeric) &&
+                     u32_read(in, &item_count) && item_count <= INT32_MAX;
+                if (!ok) break;
+
+                ObjList* list = obj_list_new();
+                objects[i] = (Obj*)list;
+                obj_list_reserve(list, (int)item_count);
+
+                if (is_numeric)
+                {
+                    if (item_count > 0)
+                    {
+                        ok = fread(list->numbers, sizeof(double), item_count,
+                                   in) == item_count;
+                        list->count = (int)item_count;
+                    }
+                }
+                else
+                {
+                    list_counts[i] = item_count;
+                }
+
+                break;
+            }
+
+            case SNAP_MAP:
+            {
+                uint32_t entry_count;
+                ok = u32_read(in, &entry_count) && entry_count <= INT32_MAX;
+                if (!ok) break;
+
+                ObjMap* map = obj_map_new();
+                objects[i] = (Obj*)map;
+                table_reserve(&map->table, (int)entry_count);
+                break;
+            }
+
+            case SNAP_BOUND_METHOD:
+            {
+                Obj* method = snap_ref_read(in, objects, i);
+                ok = method != NULL && method->type == OBJ_CLOSURE;
+                if (ok)
+                    objects[i] = (Obj*)obj_bound_method_new(
+                        value_make_nil(), (ObjClosure*)method);
+                break;
+            }
+        }
+
+        ok = ok && objects[i] != NULL;
+    }
+
+    // Fill pass: patch the references, cycles included.
+    for (uint32_t i = 0; ok && i < count; ++i)
+    {
+        switch (types[i])
+        {
+            case SNAP_UPVALUE:
+                ok = snap_value_read(in, objects, count,
+                                     &((ObjUpValue*)objects[i])->closed);
+                break;
+
+            case SNAP_CLOSURE:
+            {
+                ObjClosure* closure = (ObjClosure*)objects[i];
+
+                for (int u = 0; ok && u < closure->upvalue_count; ++u)
+                {
+                    Obj* upvalue = snap_ref_read(in, objects, count);
+                    ok = upvalue != NULL && upvalue->type == OBJ_UPVALUE;
+                    if (ok) closure->upvalues[u] = (ObjUpValue*)upvalue;
+                }
+
+                break;
+            }
+
+            case SNAP_CLASS:
+            case SNAP_INSTANCE:
+            case SNAP_MAP:
+            {
+                Table* table = types[i] == SNAP_CLASS
+                                   ? &((ObjClass*)objects[i])->methods
+                               : types[i] == SNAP_INSTANCE
+                                   ? &((ObjInstance*)objects[i])->fields
+                                   : &((ObjMap*)objects[i])->table;
+
+                uint32_t entry_count;
+                ok = u32_read(in, &entry_count) && entry_count <= INT32_MAX;
+
+                for (uint32_t e = 0; ok && e < entry_count; ++e)
+                {
+                    Obj* key = snap_ref_read(in, objects, count);
+                    ok = key != NULL && key->type == OBJ_STRING;
+
+                    Value value;
+                    ok = ok && snap_value_read(in, objects, count, &value);
+                    if (ok) table_set(table, (ObjString*)key, value);
+                }
+
+                break;
+            }
+
+            case SNAP_LIST:
+            {
+                ObjList* list = (ObjList*)objects[i];
+
+                for (uint32_t e = 0; ok && e < list_counts[i]; ++e)
+                {
+                    Value value;
+                    ok = snap_value_read(in, objects, count, &value);
+                    if (ok) obj_list_append(list, value);
+                }
+
+                break;
+            }
+
+            case SNAP_BOUND_METHOD:
+                ok = snap_value_read(
+                    in, objects, count,
+                    &((ObjBoundMethod*)objects[i])->receiver);
+                break;
+        }
+    }
+
+    // Globals pass: replay the name -> slot mapping and land the values.
+    uint32_t slot_count = 0;
+    ok = ok && u32_read(in, &slot_count) && slot_count <= INT32_MAX;
+
+    for (uint32_t slot = 0; ok && slot < slot_count; ++slot)
+    {
+        Obj* name = snap_ref_read(in, objects, count);
+        ok = name != NULL && name->type == OBJ_STRING;
+        if (!ok) break;
+
+        if (vm_global_slot((ObjString*)name) != (int)slot)
+        {
+            fprintf(stderr,
+                    "Global '%s' does not match its snapshot slot; the "
+                    "image was written by a different build.\n",
+                    obj_string_chars((ObjString*)name));
+            ok = false;
+            break;
+        }
+
+        uint8_t tag;
+        ok = u8_read(in, &tag);
+        if (!ok) break;
+
+        if (tag == SER_KEEP) continue;
+
+        ungetc(tag, in);
+        Value value;
+        ok = snap_value_read(in, objects, count, &value);
+        if (ok) vm.global_slots.values[slot] = value;
+    }
+
+    free(objects);
+    free(types);
+    free(list_counts);
+    return ok;
+}
+
+bool serialize_snapshot_read(const char* path)
+{
+    FILE* in = fopen(path, "rb");
+    if (in == NULL)
+    {
+        fprintf(stderr, "Could not open snapshot '%s'.\n", path);
+        return false;
+    }
+
+    uint32_t magic;
+    uint8_t version;
+    bool ok = u32_read(in, &magic) && magic == SNAP_MAGIC &&
+              u8_read(in, &version) && version == SNAP_VERSION;
+
+    if (!ok)
+    {
+        fprintf(stderr, "'%s' is not a compatible snapshot image.\n", path);
+    }
+    else
+    {
+        // The half-restored graph is unreachable from the roots until the
+        // globals pass lands it, so collections stay off for the restore.
+        bool gc_was_enabled = vm.gc_enabled;
+        vm.gc_enabled = false;
+
+        ok = snap_restore(in);
+
+        vm.gc_enabled = gc_was_enabled;
+
+        if (!ok)
+            fprintf(stderr, "Could not read snapshot from '%s'.\n", path);
+    }
+
+    fclose(in);
+    return ok;
+}
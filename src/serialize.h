@@ -0,0 +1,16 @@
+#ifndef CLOX_SERIALIZE_H_
+#define CLOX_SERIALIZE_H_
+
+#include "object.h"
+
+bool serialize_function_write(ObjFunction* function, const char* path);
+ObjFunction* serialize_function_read(const char* path);
+
+// Heap snapshot images: the writer captures everything reachable from the
+// global slots after a prelude ran; the reader replays the image into a
+// freshly initialized VM, restoring the warmed state without recompiling
+// or re-executing the prelude. See the SNAPSHOT section in serialize.c.
+bool serialize_snapshot_write(const char* path);
+bool serialize_snapshot_read(const char* path);
+
+#endif // CLOX_SERIALIZE_H_
@@ -8,91 +8,166 @@
 
 #define TABLE_MAX_LOAD 0.75
 
+// Probing scans a compact control-byte array before it ever touches the
+// wide Entry slots: each full slot's byte holds seven bits of its key's
+// hash, so a whole group of candidates is rejected from one cache line.
+// Deletion shifts the tail of the cluster backward instead of leaving
+// tombstones, which keeps probe chains from growing over time.
+#define CTRL_EMPTY 0x80
+#define CTRL_GROUP 8
+
+#define ctrl_h2(hash) ((uint8_t)((hash) & 0x7f))
+
+// Group scans use one word load plus bit tricks when the layout allows it;
+// elsewhere the plain byte loop below keeps the same control-first probe
+// order.
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+    defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define TABLE_USE_WORD_GROUPS
+#endif
+
+// The control array carries CTRL_GROUP mirror bytes past the end that
+// duplicate its first CTRL_GROUP entries, so group loads never have to
+// split across the wrap-around.
+static void ctrl_set(uint8_t* control, int capacity, int index, uint8_t byte)
+{
+    control[index] = byte;
+    if (index < CTRL_GROUP) control[capacity + index] = byte;
+}
+
 void table_init(Table* table)
 {
     table->count = 0;
     table->capacity = 0;
+    table->control = NULL;
     table->entries = NULL;
 }
 
 void table_free(Table* table)
 {
+    if (table->control != NULL)
+        array_free(uint8_t, table->control, table->capacity + CTRL_GROUP);
     array_free(Entry, table->entries, table->capacity);
     table_init(table);
 }
 
-static Entry* entry_find(Entry* entries, int capacity, ObjString* key)
+// Returns the slot holding `key`, or the first empty slot of its cluster
+// when the key is absent (which is exactly where an insert belongs; there
+// are no tombstones to reuse). Matches past the first empty byte belong to
+// other clusters, but checking them is harmless: the pointer compare
+// rejects them and the empty still terminates the probe.
+static int slot_find(const uint8_t* control, const Entry* entries,
+                     int capacity, uint32_t hash, ObjString* key)
 {
-    uint32_t index = key->hash & (capacity - 1);
-    Entry* tombstone = NULL;
+    uint32_t mask = capacity - 1;
+    uint32_t index = hash & mask;
+    uint8_t h2 = ctrl_h2(hash);
+
+#ifdef TABLE_USE_WORD_GROUPS
+    uint64_t match_word = UINT64_C(0x0101010101010101) * h2;
 
     while (true)
     {
-        Entry* entry = &entries[index];
+        uint64_t group;
+        memcpy(&group, control + index, sizeof(group));
+
+        // Standard SWAR zero-byte finder applied to `group ^ match_word`:
+        // every byte equal to h2 raises its high bit in `matches`.
+        uint64_t diff = group ^ match_word;
+        uint64_t matches = (diff - UINT64_C(0x0101010101010101)) & ~diff &
+                           UINT64_C(0x8080808080808080);
+
+        while (matches != 0)
+        {
+            int slot = (index + (__builtin_ctzll(matches) >> 3)) & mask;
+            if (entries[slot].key == key) return slot;
+            matches &= matches - 1;
+        }
+
+        uint64_t empties = group & UINT64_C(0x8080808080808080);
+        if (empties != 0)
+            return (index + (__builtin_ctzll(empties) >> 3)) & mask;
 
-        if (entry->key == NULL)
+        index = (index + CTRL_GROUP) & mask;
+    }
+#else
+    while (true)
+    {
+        for (int offset = 0; offset < CTRL_GROUP; ++offset)
         {
-            if (value_is_nil(entry->value))
+            uint8_t byte = control[index + offset];
+
+            if (byte == h2)
             {
-                // Empty entry.
-                return tombstone != NULL ? tombstone : entry;
+                int slot = (int)((index + offset) & mask);
+                if (entries[slot].key == key) return slot;
             }
-            else
+            else if (byte == CTRL_EMPTY)
             {
-                // We found a tombstone.
-                if (tombstone == NULL) tombstone = entry;
+                return (int)((index + offset) & mask);
             }
         }
-        else if (entry->key == key)
-        {
-            // We found the key.
-            return entry;
-        }
 
-        index = (index + 1) & (capacity - 1);
+        index = (index + CTRL_GROUP) & mask;
     }
+#endif
 }
 
 bool table_get(Table* table, ObjString* key, Value* out_value)
 {
     if (table->count == 0) return false;
 
-    Entry* entry = entry_find(table->entries, table->capacity, key);
-    if (entry->key == NULL) return false;
+    int slot = slot_find(table->control, table->entries, table->capacity,
+                         key->hash, key);
+    if (table->entries[slot].key == NULL) return false;
 
-    *out_value = entry->value;
+    *out_value = table->entries[slot].value;
     return true;
 }
 
 static void capacity_adjust(Table* table, int capacity)
 {
+    uint8_t* control = mem_alloc(uint8_t, capacity + CTRL_GROUP);
     Entry* entries = mem_alloc(Entry, capacity);
 
+    memset(control, CTRL_EMPTY, capacity + CTRL_GROUP);
     for (int i = 0; i < capacity; ++i)
     {
         entries[i].key = NULL;
         entries[i].value = value_make_nil();
     }
 
-    table->count = 0;
     for (int i = 0; i < table->capacity; ++i)
     {
         Entry* entry = &table->entries[i];
         if (entry->key == NULL) continue;
 
-        Entry* dest = entry_find(entries, capacity, entry->key);
-        dest->key = entry->key;
-        dest->value = entry->value;
-
-        table->count++;
+        int slot = slot_find(control, entries, capacity, entry->key->hash,
+                             entry->key);
+        entries[slot] = *entry;
+        ctrl_set(control, capacity, slot, ctrl_h2(entry->key->hash));
     }
 
+    if (table->control != NULL)
+        array_free(uint8_t, table->control, table->capacity + CTRL_GROUP);
     array_free(Entry, table->entries, table->capacity);
 
+    table->control = control;
     table->entries = entries;
     table->capacity = capacity;
 }
 
+// Pre-sizes the table so `count` entries insert without any rehash along
+// the way; a capacity hint for callers that know their size up front.
+void table_reserve(Table* table, int count)
+{
+    int capacity = table->capacity;
+    while (count + 1 > capacity * TABLE_MAX_LOAD)
+        capacity = capacity_grow(capacity);
+
+    if (capacity > table->capacity) capacity_adjust(table, capacity);
+}
+
 bool table_set(Table* table, ObjString* key, Value value)
 {
     if (table->count + 1 > table->capacity * TABLE_MAX_LOAD)
@@ -101,12 +176,22 @@ bool table_set(Table* table, ObjString* key, Value value)
         capacity_adjust(table, capacity);
     }
 
-    Entry* entry = entry_find(table->entries, table->capacity, key);
-    bool is_new_key = entry->key == NULL;
-    if (is_new_key && value_is_nil(entry->value)) table->count++;
+    int slot = slot_find(table->control, table->entries, table->capacity,
+                         key->hash, key);
+    bool is_new_key = table->entries[slot].key == NULL;
 
-    entry->key = key;
-    entry->value = value;
+    if (is_new_key)
+    {
+        table->count++;
+        ctrl_set(table->control, table->capacity, slot, ctrl_h2(key->hash));
+    }
+
+    table->entries[slot].key = key;
+    table->entries[slot].value = value;
+
+    // An already-scanned owner may receive young references mid-mark.
+    gc_barrier_obj((Obj*)key);
+    gc_barrier(value);
 
     return is_new_key;
 }
@@ -115,13 +200,38 @@ bool table_delete(Table* table, ObjString* key)
 {
     if (table->count == 0) return false;
 
-    // Find the entry.
-    Entry* entry = entry_find(table->entries, table->capacity, key);
-    if (entry->key == NULL) return false;
+    int hole = slot_find(table->control, table->entries, table->capacity,
+                         key->hash, key);
+    if (table->entries[hole].key == NULL) return false;
+
+    // Backward shift: walk the rest of the cluster and pull every entry
+    // that is allowed to live at the hole back into it, so lookups never
+    // need a tombstone to bridge the gap.
+    uint32_t mask = table->capacity - 1;
+    uint32_t next = ((uint32_t)hole + 1) & mask;
+
+    while (table->control[next] != CTRL_EMPTY)
+    {
+        uint32_t home = table->entries[next].key->hash & mask;
+
+        // Movable when the hole lies between the entry's home slot and its
+        // current one (cyclically); otherwise the entry is already as far
+        // back as it may go.
+        if (((next - home) & mask) >= ((next - (uint32_t)hole) & mask))
+        {
+            table->entries[hole] = table->entries[next];
+            ctrl_set(table->control, table->capacity, hole,
+                     table->control[next]);
+            hole = (int)next;
+        }
+
+        next = (next + 1) & mask;
+    }
 
-    // Place a tombstone in the entry.
-    entry->key = NULL;
-    entry->value = value_make_bool(true);
+    table->entries[hole].key = NULL;
+    table->entries[hole].value = value_make_nil();
+    ctrl_set(table->control, table->capacity, hole, CTRL_EMPTY);
+    table->count--;
 
     return true;
 }
@@ -136,30 +246,40 @@ void table_append(Table* from, Table* to)
     }
 }
 
+// The intern table's by-contents lookup; same control-first probe order as
+// slot_find(), but candidates compare length, hash and characters instead
+// of identity.
 ObjString* table_find_string(Table* table, const char* chars, int length,
                              uint32_t hash)
 {
     if (table->count == 0) return NULL;
 
-    uint32_t index = hash & (table->capacity - 1);
+    uint32_t mask = table->capacity - 1;
+    uint32_t index = hash & mask;
+    uint8_t h2 = ctrl_h2(hash);
 
     while (true)
     {
-        Entry* entry = &table->entries[index];
-
-        if (entry->key == NULL)
+        for (int offset = 0; offset < CTRL_GROUP; ++offset)
         {
-            // Stop if we find an empty non-tombstone entry.
-            if (value_is_nil(entry->value)) return NULL;
-        }
-        else if (entry->key->length == length && entry->key->hash == hash &&
-                 memcmp(entry->key->chars, chars, length) == 0)
-        {
-            // We found it.
-            return entry->key;
+            uint8_t byte = table->control[index + offset];
+
+            if (byte == h2)
+            {
+                ObjString* key = table->entries[(index + offset) & mask].key;
+
+                if (key != NULL && key->length == length &&
+                    key->hash == hash &&
+                    memcmp(key->chars, chars, length) == 0)
+                    return key;
+            }
+            else if (byte == CTRL_EMPTY)
+            {
+                return NULL;
+            }
         }
 
-        index = (index + 1) & (table->capacity - 1);
+        index = (index + CTRL_GROUP) & mask;
     }
 }
 
@@ -168,8 +288,14 @@ void gc_table_remove_white(Table* table)
     for (int i = 0; i < table->capacity; ++i)
     {
         Entry* entry = &table->entries[i];
+
         if (entry->key != NULL && !entry->key->obj.is_marked)
+        {
             table_delete(table, entry->key);
+            // The backward shift may have pulled a not-yet-visited entry
+            // into this slot; look at it again.
+            i--;
+        }
     }
 }
 
@@ -14,6 +14,9 @@ typedef struct
 {
     int count;
     int capacity;
+    // One byte per slot, probed before the entries: CTRL_EMPTY or seven
+    // bits of the resident key's hash (see src/table.c).
+    uint8_t* control;
     Entry* entries;
 } Table;
 
@@ -22,6 +25,7 @@ void table_free(Table* table);
 bool table_get(Table* table, ObjString* key, Value* out_value);
 bool table_set(Table* table, ObjString* key, Value value);
 bool table_delete(Table* table, ObjString* key);
+void table_reserve(Table* table, int count);
 void table_append(Table* from, Table* to);
 ObjString* table_find_string(Table* table, const char* chars, int length,
                              uint32_t hash);
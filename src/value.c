@@ -4,6 +4,7 @@
 #include "memory.h"
 #include "object.h"
 #include "value.h"
+#include "vm.h"
 
 bool value_check_equality(Value a, Value b)
 {
@@ -11,7 +12,14 @@ bool value_check_equality(Value a, Value b)
     if (value_is_number(a) && value_is_number(b))
         return value_as_number(a) == value_as_number(b);
 
-    return a == b;
+    if (a == b) return true;
+
+    // Ropes make string identity non-canonical, so strings fall back to a
+    // content comparison.
+    if (obj_is_string(a) && obj_is_string(b))
+        return obj_string_equal(obj_as_string(a), obj_as_string(b));
+
+    return false;
 #else
     if (a.type != b.type) return false;
 
@@ -27,6 +35,9 @@ bool value_check_equality(Value a, Value b)
             return value_as_number(a) == value_as_number(b);
 
         case VAL_OBJ:
+            if (obj_is_string(a) && obj_is_string(b))
+                return obj_string_equal(obj_as_string(a), obj_as_string(b));
+
             return value_as_obj(a) == value_as_obj(b);
 
         default:
@@ -100,6 +111,97 @@ void value_print(Value value)
         case VAL_OBJ:
             obj_print(value);
             break;
+
+        default:
+            break; // VAL_UNDEFINED never reaches user code.
+    }
+#endif
+}
+
+// Formats a number into the VM's output buffer. Tagged small integers take
+// a manual digit loop — the common case in counting loops — capped where
+// "%g" would start abbreviating; everything else goes through snprintf so
+// the text matches value_print() exactly.
+static void number_write(Value value)
+{
+    char scratch[32];
+
+    if (value_is_int(value))
+    {
+        int32_t integer = value_as_int(value);
+
+        if (integer > -1000000 && integer < 1000000)
+        {
+            char* end = scratch + sizeof(scratch);
+            char* cursor = end;
+            uint32_t magnitude =
+                integer < 0 ? (uint32_t)-integer : (uint32_t)integer;
+
+            do
+            {
+                *--cursor = (char)('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude > 0);
+
+            if (integer < 0) *--cursor = '-';
+
+            vm_out_write(cursor, (int)(end - cursor));
+            return;
+        }
+    }
+
+    int length =
+        snprintf(scratch, sizeof(scratch), "%g", value_as_number(value));
+    vm_out_write(scratch, length);
+}
+
+void value_write(Value value)
+{
+#ifdef NAN_BOXING
+    if (value_is_bool(value))
+    {
+        if (value_as_bool(value))
+            vm_out_write("true", 4);
+        else
+            vm_out_write("false", 5);
+    }
+    else if (value_is_nil(value))
+    {
+        vm_out_write("nil", 3);
+    }
+    else if (value_is_number(value))
+    {
+        number_write(value);
+    }
+    else if (value_is_obj(value))
+    {
+        obj_write(value);
+    }
+#else
+
+    switch (value.type)
+    {
+        case VAL_BOOL:
+            if (value_as_bool(value))
+                vm_out_write("true", 4);
+            else
+                vm_out_write("false", 5);
+            break;
+
+        case VAL_NIL:
+            vm_out_write("nil", 3);
+            break;
+
+        case VAL_NUMBER:
+            number_write(value);
+            break;
+
+        case VAL_OBJ:
+            obj_write(value);
+            break;
+
+        default:
+            break; // VAL_UNDEFINED never reaches user code.
     }
 #endif
 }
@@ -12,8 +12,42 @@ typedef struct ObjString ObjString;
 
 typedef uint64_t Value;
 
+#define SIGN_BIT ((uint64_t)0x8000000000000000)
+#define QNAN ((uint64_t)0x7ffc000000000000)
+
+#define TAG_NIL 1       // 01.
+#define TAG_FALSE 2     // 10.
+#define TAG_TRUE 3      // 11.
+#define TAG_UNDEFINED 0 // 00. (internal marker, never visible to scripts)
+
+// Small integers ride in the NaN space too: bit 48 separates them from the
+// singleton tags above and the low 32 bits hold a two's complement int32.
+// num_to_value() canonicalizes every integral double in range into this
+// form, so the bitwise comparisons elsewhere keep working.
+#define TAG_INT ((uint64_t)1 << 48)
+
+#define value_make_int(integer)                                                \
+    ((Value)(QNAN | TAG_INT | (uint32_t)(int32_t)(integer)))
+#define value_as_int(value) ((int32_t)(uint32_t)(value))
+#define value_is_int(value)                                                    \
+    (((value) & (SIGN_BIT | QNAN | TAG_INT)) == (QNAN | TAG_INT))
+
 static inline Value num_to_value(double num)
 {
+    if (num >= -2147483648.0 && num <= 2147483647.0)
+    {
+        int32_t small = (int32_t)num;
+
+        if ((double)small == num)
+        {
+            // -0.0 truncates to 0 but must keep its sign bit, so it stays
+            // a plain double.
+            uint64_t bits;
+            memcpy(&bits, &num, sizeof(double));
+            if (bits != SIGN_BIT) return value_make_int(small);
+        }
+    }
+
     Value value;
     memcpy(&value, &num, sizeof(double));
 
@@ -22,24 +56,20 @@ static inline Value num_to_value(double num)
 
 static inline double value_to_num(Value value)
 {
+    if (value_is_int(value)) return (double)value_as_int(value);
+
     double num;
     memcpy(&num, &value, sizeof(Value));
 
     return num;
 }
 
-#define SIGN_BIT ((uint64_t)0x8000000000000000)
-#define QNAN ((uint64_t)0x7ffc000000000000)
-
-#define TAG_NIL 1   // 01.
-#define TAG_FALSE 2 // 10.
-#define TAG_TRUE 3  // 11.
-
 #define FALSE_VAL ((Value)(uint64_t)(QNAN | TAG_FALSE))
 #define TRUE_VAL ((Value)(uint64_t)(QNAN | TAG_TRUE))
 
 #define value_make_bool(b) ((b) ? TRUE_VAL : FALSE_VAL)
 #define value_make_nil() ((Value)(uint64_t)(QNAN | TAG_NIL))
+#define value_make_undefined() ((Value)(uint64_t)(QNAN | TAG_UNDEFINED))
 #define value_make_number(number) num_to_value(number)
 #define value_make_obj(object)                                                 \
     (Value)(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)(object))
@@ -50,7 +80,9 @@ static inline double value_to_num(Value value)
 
 #define value_is_bool(value) (((value) | 1) == TRUE_VAL)
 #define value_is_nil(value) ((value) == value_make_nil())
-#define value_is_number(value) (((value) & QNAN) != QNAN)
+#define value_is_undefined(value) ((value) == value_make_undefined())
+#define value_is_number(value)                                                 \
+    ((((value) & QNAN) != QNAN) || value_is_int(value))
 #define value_is_obj(value) (((value) & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT))
 
 #else
@@ -61,6 +93,7 @@ typedef enum
     VAL_NIL,
     VAL_NUMBER,
     VAL_OBJ,
+    VAL_UNDEFINED, // internal marker, never visible to scripts
 } ValueType;
 
 typedef struct
@@ -76,6 +109,7 @@ typedef struct
 
 #define value_make_bool(value) ((Value){VAL_BOOL, {.boolean = value}})
 #define value_make_nil() ((Value){VAL_NIL, {.number = 0}})
+#define value_make_undefined() ((Value){VAL_UNDEFINED, {.number = 0}})
 #define value_make_number(value) ((Value){VAL_NUMBER, {.number = value}})
 #define value_make_obj(object) ((Value){VAL_OBJ, {.obj = (Obj*)object}})
 
@@ -85,9 +119,16 @@ typedef struct
 
 #define value_is_bool(value) ((value).type == VAL_BOOL)
 #define value_is_nil(value) ((value).type == VAL_NIL)
+#define value_is_undefined(value) ((value).type == VAL_UNDEFINED)
 #define value_is_number(value) ((value).type == VAL_NUMBER)
 #define value_is_obj(value) ((value).type == VAL_OBJ)
 
+// The union representation has no tagged integers; these fallbacks keep the
+// interpreter's integer fast paths compiling on both layouts.
+#define value_make_int(integer) value_make_number((double)(integer))
+#define value_as_int(value) ((int32_t)value_as_number(value))
+#define value_is_int(value) (false)
+
 #endif
 
 typedef struct
@@ -99,6 +140,10 @@ typedef struct
 
 bool value_check_equality(Value a, Value b);
 
+// Appends the value's printed form to the VM's output buffer; the printf
+// twin value_print() stays for diagnostics that must not be reordered.
+void value_write(Value value);
+
 void value_array_init(ValueArray* array);
 void value_array_write(ValueArray* array, Value value);
 void value_array_free(ValueArray* array);
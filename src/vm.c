@@ -1,25 +1,93 @@
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "compiler.h"
 #include "debug.h"
 #include "general.h"
 #include "memory.h"
+#include "native.h"
+#include "profiler.h"
 #include "vm.h"
+#include "worker.h"
 
-VM vm;
+// Direct-threaded dispatch relies on the labels-as-values extension, so it
+// is only honored on GCC/Clang; everywhere else `run()` keeps the portable
+// switch loop even when THREADED_DISPATCH is enabled from CMake.
+#if defined(THREADED_DISPATCH) && (defined(__GNUC__) || defined(__clang__))
+#define VM_USE_COMPUTED_GOTO
+#endif
+
+// One interpreter instance per thread: every worker gets its own stack,
+// heap, intern table and GC simply by running on its own thread.
+_Thread_local VM vm;
 
 static void vm_stack_reset()
 {
     vm.stack_top = vm.stack;
     vm.frame_count = 0;
-    vm.open_upvalues = NULL;
+    memset(vm.open_upvalues, 0, sizeof(vm.open_upvalues));
+    vm.open_upvalue_count = 0;
+    vm.closure_arena_count = 0;
+}
+
+// Appends to the VM's output buffer, flushing in VM_OUT_BUFFER_SIZE chunks.
+// This is the hot sink behind OP_PRINT/OP_PRINTLN; batching the syscalls
+// makes print-heavy scripts bound by formatting instead of stdio locking.
+// Formatting a value for this sink can allocate (value_write() flattens
+// ropes), so callers must keep the value rooted until the write returns —
+// peek, write, then pop; never write a popped temporary.
+void vm_out_write(const char* chars, int length)
+{
+    while (length > 0)
+    {
+        if (vm.out_count == VM_OUT_BUFFER_SIZE) vm_out_flush();
+
+        int room = VM_OUT_BUFFER_SIZE - vm.out_count;
+        int chunk = length < room ? length : room;
+
+        memcpy(vm.out_buffer + vm.out_count, chars, chunk);
+        vm.out_count += chunk;
+        chars += chunk;
+        length -= chunk;
+    }
+}
+
+void vm_out_flush()
+{
+    if (vm.out_count == 0) return;
+
+    if (vm.out_fd == STDOUT_FILENO)
+    {
+        // Drain through stdio so buffered script output stays ordered with
+        // the printf-based diagnostics (disassembly, stats, traces).
+        fwrite(vm.out_buffer, sizeof(char), vm.out_count, stdout);
+        fflush(stdout);
+    }
+    else
+    {
+        int written = 0;
+        while (written < vm.out_count)
+        {
+            ssize_t n = write(vm.out_fd, vm.out_buffer + written,
+                              vm.out_count - written);
+            if (n <= 0) break;
+            written += (int)n;
+        }
+    }
+
+    vm.out_count = 0;
 }
 
-static void raise_runtime_error(const char* format, ...)
+void raise_runtime_error(const char* format, ...)
 {
+    // Pending program output must land before the error does.
+    vm_out_flush();
+
     va_list args;
     va_start(args, format);
     vfprintf(stderr, format, args);
@@ -31,7 +99,8 @@ static void raise_runtime_error(const char* format, ...)
         CallFrame* frame = &vm.frames[i];
         ObjFunction* function = frame->closure->function;
         size_t instruction = frame->ip - function->chunk.code - 1;
-        fprintf(stderr, "[line %d] in ", function->chunk.lines[instruction]);
+        fprintf(stderr, "[line %d] in ",
+                chunk_get_line(&function->chunk, (int)instruction));
 
         if (function->name == NULL)
         {
@@ -46,15 +115,112 @@ static void raise_runtime_error(const char* format, ...)
     vm_stack_reset();
 }
 
+// Returns the index of `name` in the flat global slot array, appending a
+// fresh undefined slot the first time a name is seen. The compiler and the
+// native registration path share this mapping, so a name resolves to the
+// same slot for the lifetime of the VM.
+int vm_global_slot(ObjString* name)
+{
+    Value index;
+    if (table_get(&vm.global_names, name, &index))
+        return (int)value_as_number(index);
+
+    vm_stack_push(value_make_obj(name));
+    value_array_write(&vm.global_slots, value_make_undefined());
+    table_set(&vm.global_names, name,
+              value_make_number(vm.global_slots.count - 1));
+    vm_stack_pop();
+
+    return vm.global_slots.count - 1;
+}
+
+// Reverse lookup for error messages only; the hot paths never need it.
+static ObjString* global_slot_name(int slot)
+{
+    for (int i = 0; i < vm.global_names.capacity; ++i)
+    {
+        Entry* entry = &vm.global_names.entries[i];
+
+        if (entry->key != NULL && (int)value_as_number(entry->value) == slot)
+            return entry->key;
+    }
+
+    return NULL;
+}
+
 void vm_define_native_fn(const char* name, NativeFn function)
 {
     vm_stack_push(value_make_obj(obj_string_cpy(name, (int)strlen(name))));
     vm_stack_push(value_make_obj(obj_native_fn_new(function)));
-    table_set(&vm.globals, obj_as_string(vm.stack[0]), vm.stack[1]);
+
+    int slot = vm_global_slot(obj_as_string(vm.stack[0]));
+    vm.global_slots.values[slot] = vm.stack[1];
+
     vm_stack_pop();
     vm_stack_pop();
 }
 
+// out_redirect(path) reopens the VM's output sink on a freshly created
+// file; out_redirect(fd) aims it at an already open descriptor the caller
+// owns. Passing nil restores stdout. Buffered output is flushed before the
+// switch so nothing lands on the wrong sink.
+static Value native_fn_out_redirect(int argc, Value* args)
+{
+    if (argc != 1)
+    {
+        raise_runtime_error("insufficient arguments, need 1 got=%d", argc);
+        return value_make_nil();
+    }
+
+    vm_out_flush();
+
+    if (vm.out_owns_fd)
+    {
+        close(vm.out_fd);
+        vm.out_owns_fd = false;
+    }
+
+    if (value_is_nil(args[0]))
+    {
+        vm.out_fd = STDOUT_FILENO;
+        return value_make_nil();
+    }
+
+    if (value_is_number(args[0]))
+    {
+        vm.out_fd = (int)value_as_number(args[0]);
+        return value_make_nil();
+    }
+
+    if (!obj_is_string(args[0]))
+    {
+        raise_runtime_error("out_redirect expects a path, an fd or nil.");
+        return value_make_nil();
+    }
+
+    const char* path = obj_string_chars(obj_as_string(args[0]));
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0)
+    {
+        raise_runtime_error("could not open '%s' for writing.", path);
+        return value_make_nil();
+    }
+
+    vm.out_fd = fd;
+    vm.out_owns_fd = true;
+    return value_make_nil();
+}
+
+static Value native_fn_out_flush(int argc, Value* args)
+{
+    (void)argc;
+    (void)args;
+
+    vm_out_flush();
+    return value_make_nil();
+}
+
 static Value native_fn_clock(int argc, Value* args)
 {
     (void)argc;
@@ -71,6 +237,9 @@ static Value native_fn_list_length(int argc, Value* args)
         return value_make_nil();
     }
 
+    if (obj_is_map(args[0]))
+        return value_make_number(obj_as_map(args[0])->table.count);
+
     if (!obj_is_list(args[0]))
     {
         raise_runtime_error("cannot get length of a non-list variable.");
@@ -101,6 +270,30 @@ static Value native_fn_list_append(int argc, Value* args)
     return value_make_nil();
 }
 
+static Value native_fn_list_reserve(int argc, Value* args)
+{
+    if (argc != 2)
+    {
+        raise_runtime_error("insufficient arguments, need 2 got=%d", argc);
+        return value_make_nil();
+    }
+
+    if (!obj_is_list(args[0]))
+    {
+        raise_runtime_error("cannot reserve capacity on a non-list variable.");
+        return value_make_nil();
+    }
+
+    if (!value_is_number(args[1]) || value_as_number(args[1]) < 0)
+    {
+        raise_runtime_error("capacity must be a non-negative number.");
+        return value_make_nil();
+    }
+
+    obj_list_reserve(obj_as_list(args[0]), (int)value_as_number(args[1]));
+    return value_make_nil();
+}
+
 static Value native_fn_list_delete(int argc, Value* args)
 {
     if (argc != 2)
@@ -134,6 +327,429 @@ static Value native_fn_list_delete(int argc, Value* args)
     return value_make_nil();
 }
 
+// Bulk kernels over numeric lists. The unboxed double array lets the
+// compiler vectorize these loops; sum splits into four accumulators so the
+// adds overlap instead of serializing on one dependency chain. Boxed lists
+// take the scalar fallbacks below, which insist on all-number elements.
+static double numbers_sum(const double* numbers, int count)
+{
+    double sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        sum0 += numbers[i];
+        sum1 += numbers[i + 1];
+        sum2 += numbers[i + 2];
+        sum3 += numbers[i + 3];
+    }
+
+    double total = (sum0 + sum1) + (sum2 + sum3);
+    for (; i < count; ++i) total += numbers[i];
+
+    return total;
+}
+
+static ObjList* kernel_list_arg(int argc, Value* args, int needed,
+                                const char* name)
+{
+    if (argc != needed)
+    {
+        raise_runtime_error("insufficient arguments, need %d got=%d", needed,
+                            argc);
+        return NULL;
+    }
+
+    if (!obj_is_list(args[0]))
+    {
+        raise_runtime_error("%s() expects a list.", name);
+        return NULL;
+    }
+
+    return obj_as_list(args[0]);
+}
+
+static Value native_fn_list_sum(int argc, Value* args)
+{
+    ObjList* list = kernel_list_arg(argc, args, 1, "sum");
+    if (list == NULL) return value_make_nil();
+
+    if (list->is_numeric)
+        return value_make_number(numbers_sum(list->numbers, list->count));
+
+    double total = 0;
+    for (int i = 0; i < list->count; ++i)
+    {
+        Value item = obj_list_get(list, i);
+        if (!value_is_number(item))
+        {
+            raise_runtime_error("sum() expects a list of numbers.");
+            return value_make_nil();
+        }
+
+        total += value_as_number(item);
+    }
+
+    return value_make_number(total);
+}
+
+static Value native_fn_list_min_max(int argc, Value* args, bool want_min,
+                                    const char* name)
+{
+    ObjList* list = kernel_list_arg(argc, args, 1, name);
+    if (list == NULL) return value_make_nil();
+
+    if (list->count == 0)
+    {
+        raise_runtime_error("%s() of an empty list.", name);
+        return value_make_nil();
+    }
+
+    if (list->is_numeric)
+    {
+        double best = list->numbers[0];
+
+        for (int i = 1; i < list->count; ++i)
+        {
+            double number = list->numbers[i];
+            if (want_min ? number < best : number > best) best = number;
+        }
+
+        return value_make_number(best);
+    }
+
+    double best = 0;
+    for (int i = 0; i < list->count; ++i)
+    {
+        Value item = obj_list_get(list, i);
+        if (!value_is_number(item))
+        {
+            raise_runtime_error("%s() expects a list of numbers.", name);
+            return value_make_nil();
+        }
+
+        double number = value_as_number(item);
+        if (i == 0 || (want_min ? number < best : number > best))
+            best = number;
+    }
+
+    return value_make_number(best);
+}
+
+static Value native_fn_list_min(int argc, Value* args)
+{
+    return native_fn_list_min_max(argc, args, true, "min");
+}
+
+static Value native_fn_list_max(int argc, Value* args)
+{
+    return native_fn_list_min_max(argc, args, false, "max");
+}
+
+// scale(list, factor) multiplies every element in place and returns the
+// list, the map-with-scalar kernel the aggregation scripts want.
+static Value native_fn_list_scale(int argc, Value* args)
+{
+    ObjList* list = kernel_list_arg(argc, args, 2, "scale");
+    if (list == NULL) return value_make_nil();
+
+    if (!value_is_number(args[1]))
+    {
+        raise_runtime_error("scale() factor must be a number.");
+        return value_make_nil();
+    }
+
+    double factor = value_as_number(args[1]);
+
+    if (list->is_numeric)
+    {
+        for (int i = 0; i < list->count; ++i) list->numbers[i] *= factor;
+        return args[0];
+    }
+
+    for (int i = 0; i < list->count; ++i)
+    {
+        Value item = obj_list_get(list, i);
+        if (!value_is_number(item))
+        {
+            raise_runtime_error("scale() expects a list of numbers.");
+            return value_make_nil();
+        }
+
+        obj_list_set(list, i,
+                     value_make_number(value_as_number(item) * factor));
+    }
+
+    return args[0];
+}
+
+#ifdef VM_STATS
+static const char* obj_type_names[OBJ_TYPE_COUNT] = {
+    [OBJ_LIST] = "list",         [OBJ_BOUND_METHOD] = "bound method",
+    [OBJ_CLASS] = "class",       [OBJ_CLOSURE] = "closure",
+    [OBJ_FUNCTION] = "function", [OBJ_INSTANCE] = "instance",
+    [OBJ_MAP] = "map",           [OBJ_NATIVE_FN] = "native",
+    [OBJ_STRING] = "string",     [OBJ_UPVALUE] = "upvalue",
+};
+
+static void vm_stats_print()
+{
+    printf("== vm stats\n");
+    printf("instructions executed: %llu\n",
+           (unsigned long long)vm.instructions_executed);
+    printf("peak heap: %zu bytes\n", vm.peak_bytes_allocated);
+
+    printf("-- opcode counts\n");
+    for (int op = 0; op < OP_CODE_COUNT; ++op)
+    {
+        if (vm.opcode_counts[op] == 0) continue;
+        printf("%-24s %llu\n", opcode_name((uint8_t)op),
+               (unsigned long long)vm.opcode_counts[op]);
+    }
+
+    printf("-- allocations by type\n");
+    for (int type = 0; type < OBJ_TYPE_COUNT; ++type)
+    {
+        if (vm.alloc_counts[type] == 0) continue;
+        printf("%-24s %llu\n", obj_type_names[type],
+               (unsigned long long)vm.alloc_counts[type]);
+    }
+
+    printf("-- gc\n");
+    printf("cycles completed: %llu\n", (unsigned long long)vm.gc_cycles);
+    printf("pauses:    <10us %llu   <100us %llu   <1ms %llu   <10ms %llu   "
+           ">=10ms %llu\n",
+           (unsigned long long)vm.gc_pause_buckets[0],
+           (unsigned long long)vm.gc_pause_buckets[1],
+           (unsigned long long)vm.gc_pause_buckets[2],
+           (unsigned long long)vm.gc_pause_buckets[3],
+           (unsigned long long)vm.gc_pause_buckets[4]);
+    printf("reclaimed: <4KB %llu   <64KB %llu   <1MB %llu   <16MB %llu   "
+           ">=16MB %llu\n",
+           (unsigned long long)vm.gc_reclaim_buckets[0],
+           (unsigned long long)vm.gc_reclaim_buckets[1],
+           (unsigned long long)vm.gc_reclaim_buckets[2],
+           (unsigned long long)vm.gc_reclaim_buckets[3],
+           (unsigned long long)vm.gc_reclaim_buckets[4]);
+}
+
+static Value native_fn_stats(int argc, Value* args)
+{
+    (void)argc;
+    (void)args;
+
+    vm_out_flush();
+    vm_stats_print();
+    return value_make_nil();
+}
+#endif
+
+#define VM_GC_INITIAL_THRESHOLD (1024 * 1024)
+#define VM_GC_GROW_FACTOR 2.0
+
+// Reads a byte count like "64m" or "8g" from the environment; a missing or
+// unparsable value keeps the built-in default.
+static size_t gc_env_bytes(const char* name, size_t fallback)
+{
+    const char* text = getenv(name);
+    if (text == NULL || text[0] == '\0') return fallback;
+
+    char* end;
+    unsigned long long bytes = strtoull(text, &end, 10);
+    if (end == text || bytes == 0) return fallback;
+
+    switch (*end)
+    {
+        case 'k':
+        case 'K':
+            return (size_t)bytes << 10;
+        case 'm':
+        case 'M':
+            return (size_t)bytes << 20;
+        case 'g':
+        case 'G':
+            return (size_t)bytes << 30;
+        case '\0':
+            return (size_t)bytes;
+        default:
+            return fallback;
+    }
+}
+
+static double gc_env_factor(const char* name, double fallback)
+{
+    const char* text = getenv(name);
+    if (text == NULL || text[0] == '\0') return fallback;
+
+    char* end;
+    double factor = strtod(text, &end);
+
+    // Anything that barely grows the threshold would collect continuously.
+    return end != text && factor >= 1.1 ? factor : fallback;
+}
+
+// gc_collect() runs a full stop-the-world cycle and returns the bytes it
+// reclaimed. gc_disable()/gc_enable() gate the automatic triggers around
+// known allocation bursts — an explicit gc_collect() still works while
+// disabled — and gc_bytes_allocated() reports the live heap counter.
+// Table probes compare keys by pointer and rely on interning. Literal keys
+// are interned constants, but a key built at runtime (e.g. by
+// concatenation) may be a rope whose canonical twin already exists, so map
+// operations resolve every dynamic key through the intern table first.
+static ObjString* map_key_canonical(ObjString* key)
+{
+    obj_string_chars(key); // Flattening interns the key if nothing equal.
+
+    ObjString* interned = table_find_string(&vm.strings, key->chars,
+                                            key->length, key->hash);
+    return interned != NULL ? interned : key;
+}
+
+static Value native_fn_map_make(int argc, Value* args)
+{
+    if (argc > 1)
+    {
+        raise_runtime_error("too many arguments, need at most 1 got=%d",
+                            argc);
+        return value_make_nil();
+    }
+
+    if (argc == 1 &&
+        (!value_is_number(args[0]) || value_as_number(args[0]) < 0))
+    {
+        raise_runtime_error("capacity must be a non-negative number.");
+        return value_make_nil();
+    }
+
+    ObjMap* map = obj_map_new();
+
+    if (argc == 1)
+    {
+        // Rooted while the capacity hint allocates the backing arrays.
+        vm_stack_push(value_make_obj(map));
+        table_reserve(&map->table, (int)value_as_number(args[0]));
+        vm_stack_pop();
+    }
+
+    return value_make_obj(map);
+}
+
+static Value native_fn_map_keys(int argc, Value* args)
+{
+    if (argc != 1)
+    {
+        raise_runtime_error("insufficient arguments, need 1 got=%d", argc);
+        return value_make_nil();
+    }
+
+    if (!obj_is_map(args[0]))
+    {
+        raise_runtime_error("keys() expects a map.");
+        return value_make_nil();
+    }
+
+    Table* table = &obj_as_map(args[0])->table;
+
+    ObjList* list = obj_list_new();
+    vm_stack_push(value_make_obj(list));
+    obj_list_reserve(list, table->count);
+
+    for (int i = 0; i < table->capacity; ++i)
+        if (table->entries[i].key != NULL)
+            obj_list_append(list, value_make_obj(table->entries[i].key));
+
+    return vm_stack_pop();
+}
+
+static Value native_fn_map_has(int argc, Value* args)
+{
+    if (argc != 2)
+    {
+        raise_runtime_error("insufficient arguments, need 2 got=%d", argc);
+        return value_make_nil();
+    }
+
+    if (!obj_is_map(args[0]))
+    {
+        raise_runtime_error("has() expects a map.");
+        return value_make_nil();
+    }
+
+    if (!obj_is_string(args[1]))
+    {
+        raise_runtime_error("map key is not a string.");
+        return value_make_nil();
+    }
+
+    Value value;
+    return value_make_bool(
+        table_get(&obj_as_map(args[0])->table,
+                  map_key_canonical(obj_as_string(args[1])), &value));
+}
+
+static Value native_fn_map_remove(int argc, Value* args)
+{
+    if (argc != 2)
+    {
+        raise_runtime_error("insufficient arguments, need 2 got=%d", argc);
+        return value_make_nil();
+    }
+
+    if (!obj_is_map(args[0]))
+    {
+        raise_runtime_error("remove() expects a map.");
+        return value_make_nil();
+    }
+
+    if (!obj_is_string(args[1]))
+    {
+        raise_runtime_error("map key is not a string.");
+        return value_make_nil();
+    }
+
+    return value_make_bool(
+        table_delete(&obj_as_map(args[0])->table,
+                     map_key_canonical(obj_as_string(args[1]))));
+}
+
+static Value native_fn_gc_collect(int argc, Value* args)
+{
+    (void)argc;
+    (void)args;
+
+    size_t before = vm.bytes_allocated;
+    gc_perform();
+
+    size_t after = vm.bytes_allocated;
+    return value_make_number(before > after ? (double)(before - after) : 0);
+}
+
+static Value native_fn_gc_disable(int argc, Value* args)
+{
+    (void)argc;
+    (void)args;
+
+    vm.gc_enabled = false;
+    return value_make_nil();
+}
+
+static Value native_fn_gc_enable(int argc, Value* args)
+{
+    (void)argc;
+    (void)args;
+
+    vm.gc_enabled = true;
+    return value_make_nil();
+}
+
+static Value native_fn_gc_bytes_allocated(int argc, Value* args)
+{
+    (void)argc;
+    (void)args;
+
+    return value_make_number((double)vm.bytes_allocated);
+}
+
 void vm_init()
 {
     vm_stack_reset();
@@ -143,24 +759,84 @@ void vm_init()
     vm.gray_capacity = 0;
     vm.gray_stack = NULL;
     vm.bytes_allocated = 0;
-    vm.next_gc = 1024 * 1024;
+    vm.next_gc = gc_env_bytes("CLOX_GC_THRESHOLD", VM_GC_INITIAL_THRESHOLD);
+    vm.gc_grow_factor = gc_env_factor("CLOX_GC_GROW_FACTOR",
+                                      VM_GC_GROW_FACTOR);
+    vm.gc_enabled = true;
+
+#ifdef VM_STATS
+    vm.instructions_executed = 0;
+    vm.peak_bytes_allocated = 0;
+    vm.gc_cycles = 0;
+    memset(vm.opcode_counts, 0, sizeof(vm.opcode_counts));
+    memset(vm.alloc_counts, 0, sizeof(vm.alloc_counts));
+    memset(vm.gc_pause_buckets, 0, sizeof(vm.gc_pause_buckets));
+    memset(vm.gc_reclaim_buckets, 0, sizeof(vm.gc_reclaim_buckets));
+#endif
 
-    table_init(&vm.globals);
+    table_init(&vm.global_names);
+    value_array_init(&vm.global_slots);
     table_init(&vm.strings);
+    table_init(&vm.repl_cache);
+    value_array_init(&vm.pins);
 
     vm.init_str = NULL;
     vm.init_str = obj_string_cpy("init", 4);
 
-    vm_define_native_fn("clock", native_fn_clock);
-    vm_define_native_fn("length", native_fn_list_length);
-    vm_define_native_fn("append", native_fn_list_append);
-    vm_define_native_fn("delete", native_fn_list_delete);
+    vm.out_count = 0;
+    vm.out_fd = STDOUT_FILENO;
+    vm.out_owns_fd = false;
+
+    static const NativeEntry builtins[] = {
+        {"clock", native_fn_clock},
+        {"length", native_fn_list_length},
+        {"append", native_fn_list_append},
+        {"reserve", native_fn_list_reserve},
+        {"delete", native_fn_list_delete},
+        {"sum", native_fn_list_sum},
+        {"min", native_fn_list_min},
+        {"max", native_fn_list_max},
+        {"scale", native_fn_list_scale},
+        {"map", native_fn_map_make},
+        {"keys", native_fn_map_keys},
+        {"has", native_fn_map_has},
+        {"remove", native_fn_map_remove},
+        {"out_redirect", native_fn_out_redirect},
+        {"out_flush", native_fn_out_flush},
+        {"gc_collect", native_fn_gc_collect},
+        {"gc_disable", native_fn_gc_disable},
+        {"gc_enable", native_fn_gc_enable},
+        {"gc_bytes_allocated", native_fn_gc_bytes_allocated},
+    };
+    vm_define_native_table(builtins,
+                           (int)(sizeof(builtins) / sizeof(builtins[0])));
+    profiler_natives_define();
+    worker_natives_define();
+
+#ifdef VM_STATS
+    vm_define_native_fn("stats", native_fn_stats);
+#endif
+
+    // Extension modules last, so they may shadow builtins on purpose.
+    native_modules_load();
 }
 
 void vm_free()
 {
-    table_free(&vm.globals);
+    vm_out_flush();
+
+    if (vm.out_owns_fd)
+    {
+        close(vm.out_fd);
+        vm.out_fd = STDOUT_FILENO;
+        vm.out_owns_fd = false;
+    }
+
+    table_free(&vm.global_names);
+    value_array_free(&vm.global_slots);
     table_free(&vm.strings);
+    table_free(&vm.repl_cache);
+    value_array_free(&vm.pins);
 
     vm.init_str = NULL;
 
@@ -203,6 +879,7 @@ static bool obj_func_call(ObjClosure* closure, int argc)
     frame->closure = closure;
     frame->ip = closure->function->chunk.code;
     frame->slots = vm.stack_top - argc - 1;
+    frame->arena_mark = vm.closure_arena_count;
     return true;
 }
 
@@ -260,6 +937,54 @@ static bool value_call(Value callee, int argc)
     return false;
 }
 
+// Returns the inline-cache slot for the frame's current ip, allocating the
+// chunk's cache array on first use. Chunks are immutable once compiled, so
+// one slot per bytecode offset uniquely identifies a call site.
+static PropertyCache* prop_cache_get(CallFrame* frame)
+{
+    Chunk* chunk = &frame->closure->function->chunk;
+
+    if (chunk->prop_caches == NULL)
+    {
+        chunk->prop_caches = mem_alloc(PropertyCache, chunk->count);
+
+        for (int i = 0; i < chunk->count; ++i)
+        {
+            chunk->prop_caches[i].cls = NULL;
+            chunk->prop_caches[i].method = value_make_nil();
+        }
+    }
+
+    return &chunk->prop_caches[frame->ip - chunk->code];
+}
+
+// Looks the method up through the call site's cache first, falling back to
+// the class's method table (and refilling the cache) when the receiver
+// class changed since the last execution.
+static bool method_resolve(PropertyCache* cache, ObjClass* cls,
+                           ObjString* name, Value* out_method)
+{
+    if (cache != NULL && cache->cls == (Obj*)cls)
+    {
+        *out_method = cache->method;
+        return true;
+    }
+
+    if (!table_get(&cls->methods, name, out_method)) return false;
+
+    if (cache != NULL)
+    {
+        cache->cls = (Obj*)cls;
+        cache->method = *out_method;
+
+        // The cache lives in a possibly-black function object.
+        gc_barrier_obj(cache->cls);
+        gc_barrier(cache->method);
+    }
+
+    return true;
+}
+
 static bool invoke_from_class(ObjClass* cls, ObjString* name, int argc)
 {
     Value method;
@@ -272,7 +997,7 @@ static bool invoke_from_class(ObjClass* cls, ObjString* name, int argc)
     return obj_func_call(obj_as_closure(method), argc);
 }
 
-static bool invoke(ObjString* name, int argc)
+static bool invoke(ObjString* name, int argc, PropertyCache* cache)
 {
     Value receiver = vm_stack_peek(argc);
 
@@ -291,44 +1016,72 @@ static bool invoke(ObjString* name, int argc)
         return value_call(value, argc);
     }
 
-    return invoke_from_class(instance->cls, name, argc);
+    Value method;
+    if (!method_resolve(cache, instance->cls, name, &method))
+    {
+        raise_runtime_error("Undefined property '%s'.", name->chars);
+        return false;
+    }
+
+    return obj_func_call(obj_as_closure(method), argc);
 }
 
-static ObjUpValue* upvalue_capture(Value* local)
+// Bump allocation out of the frame-lifetime closure arena; NULL when the
+// request doesn't fit, in which case the caller heap-allocates instead.
+static uint8_t* closure_arena_alloc(size_t size)
 {
-    ObjUpValue* prev_upvalue = NULL;
-    ObjUpValue* upvalue = vm.open_upvalues;
-    while (upvalue != NULL && upvalue->location > local)
-    {
-        prev_upvalue = upvalue;
-        upvalue = upvalue->next;
-    }
+    if ((size_t)vm.closure_arena_count + size > CLOSURE_ARENA_SIZE)
+        return NULL;
 
-    if (upvalue != NULL && upvalue->location == local) return upvalue;
+    uint8_t* block = vm.closure_arena + vm.closure_arena_count;
+    vm.closure_arena_count += (int)size;
+    return block;
+}
 
-    ObjUpValue* created_upvalue = obj_upvalue_new(local);
-    created_upvalue->next = upvalue;
+// True when the object lives in the closure arena, i.e. it was created by
+// OP_CLOSURE_STACK and its storage dies with the owning frame.
+static bool closure_is_arena(ObjClosure* closure)
+{
+    uint8_t* address = (uint8_t*)closure;
+    return address >= vm.closure_arena &&
+           address < vm.closure_arena + CLOSURE_ARENA_SIZE;
+}
 
-    if (prev_upvalue == NULL)
-    {
-        vm.open_upvalues = created_upvalue;
-    }
-    else
-    {
-        prev_upvalue->next = created_upvalue;
-    }
+static ObjUpValue* upvalue_capture(Value* local)
+{
+    int slot = (int)(local - vm.stack);
+
+    ObjUpValue* existing = vm.open_upvalues[slot];
+    if (existing != NULL) return existing;
 
+    ObjUpValue* created_upvalue = obj_upvalue_new(local);
+    vm.open_upvalues[slot] = created_upvalue;
+    vm.open_upvalue_count++;
     return created_upvalue;
 }
 
+// Closes every open upvalue at or above `last`. Captured locals are always
+// closed before their slot is popped, so the scan is bounded by the live
+// stack top: OP_CLOSE_UPVALUE touches one slot and OP_RETURN touches only
+// the returning frame's window, independent of how many upvalues older
+// frames hold open.
 static void upvalue_close_until(Value* last)
 {
-    while (vm.open_upvalues != NULL && vm.open_upvalues->location >= last)
+    if (vm.open_upvalue_count == 0) return;
+
+    int first = (int)(last - vm.stack);
+    for (int slot = (int)(vm.stack_top - vm.stack) - 1; slot >= first;
+         --slot)
     {
-        ObjUpValue* upvalue = vm.open_upvalues;
+        ObjUpValue* upvalue = vm.open_upvalues[slot];
+        if (upvalue == NULL) continue;
+
         upvalue->closed = *upvalue->location;
         upvalue->location = &upvalue->closed;
-        vm.open_upvalues = upvalue->next;
+        vm.open_upvalues[slot] = NULL;
+        vm.open_upvalue_count--;
+
+        gc_barrier(upvalue->closed);
     }
 }
 
@@ -363,19 +1116,31 @@ static void string_concat()
     ObjString* b = obj_as_string(vm_stack_peek(0));
     ObjString* a = obj_as_string(vm_stack_peek(1));
 
-    int length = a->length + b->length;
-    char* chars = mem_alloc(char, length + 1);
-    memcpy(chars, a->chars, a->length);
-    memcpy(chars + a->length, b->chars, b->length);
-    chars[length] = '\0';
+    ObjString* result = obj_string_concat(a, b);
 
-    ObjString* result = obj_string_take(chars, length);
     vm_stack_pop();
     vm_stack_pop();
 
     vm_stack_push(value_make_obj(result));
 }
 
+// Arithmetic on tagged integers widens to 64 bits first; a result that no
+// longer fits an int32 falls back to the double representation.
+static inline Value int_result(int64_t num)
+{
+    if (num >= INT32_MIN && num <= INT32_MAX)
+        return value_make_int((int32_t)num);
+
+    return value_make_number((double)num);
+}
+
+// Taking the address of a label is not ISO C, so the threaded build keeps
+// the pedantic warnings quiet for this function only.
+#ifdef VM_USE_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
 static InterpretResult run()
 {
     CallFrame* frame = &vm.frames[vm.frame_count - 1];
@@ -391,129 +1156,316 @@ static InterpretResult run()
 #define binary_op(value_type, op)                                              \
     do                                                                         \
     {                                                                          \
-        if (!value_is_number(vm_stack_peek(0)) ||                              \
-            !value_is_number(vm_stack_peek(1)))                                \
+        if (!value_is_number(vm_stack_peek(0)) ||                              \
+            !value_is_number(vm_stack_peek(1)))                                \
+        {                                                                      \
+            raise_runtime_error("Operand must be numbers.");                   \
+            return INTERPRET_RUNTIME_ERROR;                                    \
+        }                                                                      \
+        double b = value_as_number(vm_stack_pop());                            \
+        double a = value_as_number(vm_stack_pop());                            \
+        vm_stack_push(value_make_##value_type(a op b));                        \
+    } while (false)
+
+// Integer fast path for operators that are exact on integers (division is
+// not and keeps plain binary_op). int_result_* picks how the widened result
+// is boxed: arithmetic re-tags through int_result, comparisons make a bool.
+#define int_result_number(num) int_result(num)
+#define int_result_bool(flag) value_make_bool(flag)
+#define binary_op_fast(value_type, op)                                         \
+    do                                                                         \
+    {                                                                          \
+        if (value_is_int(vm_stack_peek(0)) &&                                  \
+            value_is_int(vm_stack_peek(1)))                                    \
+        {                                                                      \
+            int64_t b = value_as_int(vm_stack_pop());                          \
+            int64_t a = value_as_int(vm_stack_pop());                          \
+            vm_stack_push(int_result_##value_type(a op b));                    \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            if (!value_is_number(vm_stack_peek(0)) ||                          \
+                !value_is_number(vm_stack_peek(1)))                            \
+            {                                                                  \
+                raise_runtime_error("Operand must be numbers.");               \
+                return INTERPRET_RUNTIME_ERROR;                                \
+            }                                                                  \
+            double b = value_as_number(vm_stack_pop());                        \
+            double a = value_as_number(vm_stack_pop());                        \
+            vm_stack_push(value_make_##value_type(a op b));                    \
+        }                                                                      \
+    } while (false)
+
+#ifdef DEBUG_TRACE_EXECUTION
+#define trace_execution()                                                      \
+    do                                                                         \
+    {                                                                          \
+        printf("%s", "          ");                                            \
+        for (Value* slot = vm.stack; slot < vm.stack_top; ++slot)              \
         {                                                                      \
-            raise_runtime_error("Operand must be numbers.");                   \
-            return INTERPRET_RUNTIME_ERROR;                                    \
+            printf("%s", "[ ");                                                \
+            value_print(*slot);                                                \
+            printf("%s", " ]");                                                \
         }                                                                      \
-        double b = value_as_number(vm_stack_pop());                            \
-        double a = value_as_number(vm_stack_pop());                            \
-        vm_stack_push(value_make_##value_type(a op b));                        \
+                                                                               \
+        puts("");                                                              \
+                                                                               \
+        instruction_disassemble(                                               \
+            &frame->closure->function->chunk,                                  \
+            (int)(frame->ip - frame->closure->function->chunk.code));          \
     } while (false)
+#else
+#define trace_execution()
+#endif
 
-    while (true)
-    {
-#ifdef DEBUG_TRACE_EXECUTION
-        printf("%s", "          ");
-        for (Value* slot = vm.stack; slot < vm.stack_top; ++slot)
-        {
-            printf("%s", "[ ");
-            value_print(*slot);
-            printf("%s", " ]");
-        }
+// The per-opcode count peeks the opcode about to be fetched, so the macro
+// must run before byte_read() advances the instruction pointer.
+#ifdef VM_STATS
+#define count_instruction()                                                    \
+    (vm.instructions_executed++, vm.opcode_counts[*frame->ip]++)
+#else
+#define count_instruction()
+#endif
 
-        puts("");
+#ifdef VM_USE_COMPUTED_GOTO
+    static void* dispatch_table[] = {
+        [OP_CONSTANT] = &&target_OP_CONSTANT,
+        [OP_CONSTANT_LONG] = &&target_OP_CONSTANT_LONG,
+        [OP_NIL] = &&target_OP_NIL,
+        [OP_TRUE] = &&target_OP_TRUE,
+        [OP_FALSE] = &&target_OP_FALSE,
+        [OP_POP] = &&target_OP_POP,
+        [OP_GET_LOCAL] = &&target_OP_GET_LOCAL,
+        [OP_SET_LOCAL] = &&target_OP_SET_LOCAL,
+        [OP_GET_GLOBAL] = &&target_OP_GET_GLOBAL,
+        [OP_DEFINE_GLOBAL] = &&target_OP_DEFINE_GLOBAL,
+        [OP_SET_GLOBAL] = &&target_OP_SET_GLOBAL,
+        [OP_GET_GLOBAL_SLOT] = &&target_OP_GET_GLOBAL_SLOT,
+        [OP_DEFINE_GLOBAL_SLOT] = &&target_OP_DEFINE_GLOBAL_SLOT,
+        [OP_SET_GLOBAL_SLOT] = &&target_OP_SET_GLOBAL_SLOT,
+        [OP_GET_UPVALUE] = &&target_OP_GET_UPVALUE,
+        [OP_SET_UPVALUE] = &&target_OP_SET_UPVALUE,
+        [OP_GET_PROPERTY] = &&target_OP_GET_PROPERTY,
+        [OP_SET_PROPERTY] = &&target_OP_SET_PROPERTY,
+        [OP_GET_SUPER] = &&target_OP_GET_SUPER,
+        [OP_EQUAL] = &&target_OP_EQUAL,
+        [OP_GREATER] = &&target_OP_GREATER,
+        [OP_LESS] = &&target_OP_LESS,
+        [OP_ADD] = &&target_OP_ADD,
+        [OP_SUBTRACT] = &&target_OP_SUBTRACT,
+        [OP_MULTIPLY] = &&target_OP_MULTIPLY,
+        [OP_DIVIDE] = &&target_OP_DIVIDE,
+        [OP_NOT] = &&target_OP_NOT,
+        [OP_NEGATE] = &&target_OP_NEGATE,
+        [OP_PRINT] = &&target_OP_PRINT,
+        [OP_PRINTLN] = &&target_OP_PRINTLN,
+        [OP_JUMP] = &&target_OP_JUMP,
+        [OP_JUMP_IF_FALSE] = &&target_OP_JUMP_IF_FALSE,
+        [OP_LOOP] = &&target_OP_LOOP,
+        [OP_CALL] = &&target_OP_CALL,
+        [OP_TAIL_CALL] = &&target_OP_TAIL_CALL,
+        [OP_INVOKE] = &&target_OP_INVOKE,
+        [OP_SUPER_INVOKE] = &&target_OP_SUPER_INVOKE,
+        [OP_CLOSURE] = &&target_OP_CLOSURE,
+        [OP_CLOSURE_STACK] = &&target_OP_CLOSURE_STACK,
+        [OP_CLOSE_UPVALUE] = &&target_OP_CLOSE_UPVALUE,
+        [OP_LIST_INIT] = &&target_OP_LIST_INIT,
+        [OP_LIST_GETIDX] = &&target_OP_LIST_GETIDX,
+        [OP_LIST_SETIDX] = &&target_OP_LIST_SETIDX,
+        [OP_MAP_GETIDX] = &&target_OP_MAP_GETIDX,
+        [OP_MAP_SETIDX] = &&target_OP_MAP_SETIDX,
+        [OP_GET_LOCAL_CONST_ADD] = &&target_OP_GET_LOCAL_CONST_ADD,
+        [OP_ADD_SET_LOCAL] = &&target_OP_ADD_SET_LOCAL,
+        [OP_LESS_JUMP_IF_FALSE] = &&target_OP_LESS_JUMP_IF_FALSE,
+        [OP_RETURN] = &&target_OP_RETURN,
+        [OP_CLASS] = &&target_OP_CLASS,
+        [OP_INHERIT] = &&target_OP_INHERIT,
+        [OP_METHOD] = &&target_OP_METHOD,
+    };
+
+#define vm_dispatch()                                                          \
+    do                                                                         \
+    {                                                                          \
+        trace_execution();                                                     \
+        count_instruction();                                                   \
+        goto* dispatch_table[byte_read()];                                     \
+    } while (false)
 
-        instruction_disassemble(
-            &frame->closure->function->chunk,
-            (int)(frame->ip - frame->closure->function->chunk.code));
+#define vm_loop_begin() vm_dispatch();
+#define vm_case(opcode) target_##opcode
+#define vm_break() vm_dispatch()
+#else
+#define vm_loop_begin()                                                        \
+    trace_execution();                                                         \
+    count_instruction();                                                       \
+    switch (byte_read())
+#define vm_case(opcode) case opcode
+#define vm_break() break
 #endif
-        uint8_t instruction;
-        switch (instruction = byte_read())
+
+    while (true)
+    {
+        vm_loop_begin()
         {
-            case OP_CONSTANT:
+            vm_case(OP_CONSTANT):
             {
                 Value constant = byte_read_constant();
                 vm_stack_push(constant);
-                break;
+                vm_break();
+            }
+
+            vm_case(OP_CONSTANT_LONG):
+            {
+                int index = byte_read() << 16;
+                index |= byte_read() << 8;
+                index |= byte_read();
+                vm_stack_push(
+                    frame->closure->function->chunk.constants.values[index]);
+                vm_break();
             }
 
-            case OP_NIL:
+            vm_case(OP_NIL):
                 vm_stack_push(value_make_nil());
-                break;
+                vm_break();
 
-            case OP_TRUE:
+            vm_case(OP_TRUE):
                 vm_stack_push(value_make_bool(true));
-                break;
+                vm_break();
 
-            case OP_FALSE:
+            vm_case(OP_FALSE):
                 vm_stack_push(value_make_bool(false));
-                break;
+                vm_break();
 
-            case OP_POP:
+            vm_case(OP_POP):
                 vm_stack_pop();
-                break;
+                vm_break();
 
-            case OP_GET_LOCAL:
+            vm_case(OP_GET_LOCAL):
             {
                 uint8_t slot = byte_read();
                 vm_stack_push(frame->slots[slot]);
-                break;
+                vm_break();
             }
 
-            case OP_SET_LOCAL:
+            vm_case(OP_SET_LOCAL):
             {
                 uint8_t slot = byte_read();
                 frame->slots[slot] = vm_stack_peek(0);
-                break;
+                vm_break();
             }
 
-            case OP_GET_GLOBAL:
+            // The by-name global opcodes are the late-bound fallback; the
+            // compiler emits the slot-indexed variants whenever a name fits
+            // in the single-byte slot operand.
+            vm_case(OP_GET_GLOBAL):
             {
                 ObjString* name = byte_read_string();
-                Value value;
+                Value index;
 
-                if (!table_get(&vm.globals, name, &value))
+                if (!table_get(&vm.global_names, name, &index) ||
+                    value_is_undefined(
+                        vm.global_slots
+                            .values[(int)value_as_number(index)]))
                 {
                     raise_runtime_error("Undefined symbol '%s'.", name->chars);
 
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                vm_stack_push(value);
-                break;
+                vm_stack_push(
+                    vm.global_slots.values[(int)value_as_number(index)]);
+                vm_break();
             }
 
-            case OP_DEFINE_GLOBAL:
+            vm_case(OP_DEFINE_GLOBAL):
             {
                 ObjString* name = byte_read_string();
-                table_set(&vm.globals, name, vm_stack_peek(0));
+                int slot = vm_global_slot(name);
+                vm.global_slots.values[slot] = vm_stack_peek(0);
                 vm_stack_pop();
-                break;
+                vm_break();
             }
 
-            case OP_SET_GLOBAL:
+            vm_case(OP_SET_GLOBAL):
             {
                 ObjString* name = byte_read_string();
+                Value index;
 
-                if (table_set(&vm.globals, name, vm_stack_peek(0)))
+                if (!table_get(&vm.global_names, name, &index) ||
+                    value_is_undefined(
+                        vm.global_slots
+                            .values[(int)value_as_number(index)]))
                 {
-                    table_delete(&vm.globals, name);
                     raise_runtime_error("Undefined variable '%s'.",
                                         name->chars);
 
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                break;
+                vm.global_slots.values[(int)value_as_number(index)] =
+                    vm_stack_peek(0);
+                vm_break();
+            }
+
+            vm_case(OP_GET_GLOBAL_SLOT):
+            {
+                Value value = vm.global_slots.values[byte_read()];
+
+                if (value_is_undefined(value))
+                {
+                    raise_runtime_error(
+                        "Undefined symbol '%s'.",
+                        global_slot_name(frame->ip[-1])->chars);
+
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                vm_stack_push(value);
+                vm_break();
+            }
+
+            vm_case(OP_DEFINE_GLOBAL_SLOT):
+            {
+                vm.global_slots.values[byte_read()] = vm_stack_peek(0);
+                vm_stack_pop();
+                vm_break();
+            }
+
+            vm_case(OP_SET_GLOBAL_SLOT):
+            {
+                uint8_t slot = byte_read();
+
+                if (value_is_undefined(vm.global_slots.values[slot]))
+                {
+                    raise_runtime_error("Undefined variable '%s'.",
+                                        global_slot_name(slot)->chars);
+
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                vm.global_slots.values[slot] = vm_stack_peek(0);
+                vm_break();
             }
 
-            case OP_GET_UPVALUE:
+            vm_case(OP_GET_UPVALUE):
             {
                 uint8_t slot = byte_read();
                 vm_stack_push(*frame->closure->upvalues[slot]->location);
-                break;
+                vm_break();
             }
 
-            case OP_SET_UPVALUE:
+            vm_case(OP_SET_UPVALUE):
             {
                 uint8_t slot = byte_read();
                 *frame->closure->upvalues[slot]->location = vm_stack_peek(0);
-                break;
+
+                // A closed upvalue is heap storage, so the store needs the
+                // write barrier just like a field write.
+                gc_barrier(vm_stack_peek(0));
+                vm_break();
             }
 
-            case OP_GET_PROPERTY:
+            vm_case(OP_GET_PROPERTY):
             {
                 if (!obj_is_instance(vm_stack_peek(0)))
                 {
@@ -529,18 +1481,28 @@ static InterpretResult run()
                 {
                     vm_stack_pop(); // Instance
                     vm_stack_push(value);
-                    break;
+                    vm_break();
                 }
 
-                if (!bind_method(instance->cls, name))
+                Value method;
+                if (!method_resolve(prop_cache_get(frame), instance->cls, name,
+                                    &method))
                 {
+                    raise_runtime_error("Undefined property '%s'.",
+                                        name->chars);
+
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                break;
+                ObjBoundMethod* bound = obj_bound_method_new(
+                    vm_stack_peek(0), obj_as_closure(method));
+
+                vm_stack_pop();
+                vm_stack_push(value_make_obj(bound));
+                vm_break();
             }
 
-            case OP_SET_PROPERTY:
+            vm_case(OP_SET_PROPERTY):
             {
                 if (!obj_is_instance(vm_stack_peek(1)))
                 {
@@ -555,10 +1517,10 @@ static InterpretResult run()
                 Value value = vm_stack_pop();
                 vm_stack_pop();
                 vm_stack_push(value);
-                break;
+                vm_break();
             }
 
-            case OP_GET_SUPER:
+            vm_case(OP_GET_SUPER):
             {
                 ObjString* name = byte_read_string();
                 ObjClass* superclass = obj_as_class(vm_stack_pop());
@@ -568,30 +1530,42 @@ static InterpretResult run()
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                break;
+                vm_break();
             }
 
-            case OP_EQUAL:
+            vm_case(OP_EQUAL):
             {
-                Value b = vm_stack_pop();
-                Value a = vm_stack_pop();
+                // Equality may flatten rope strings, which allocates, so
+                // the operands stay rooted until they are compared.
+                bool equal =
+                    value_check_equality(vm_stack_peek(1), vm_stack_peek(0));
 
-                vm_stack_push(value_make_bool(value_check_equality(a, b)));
-                break;
+                vm_stack_pop();
+                vm_stack_pop();
+                vm_stack_push(value_make_bool(equal));
+                vm_break();
             }
 
-            case OP_GREATER:
-                binary_op(bool, >);
-                break;
+            vm_case(OP_GREATER):
+                binary_op_fast(bool, >);
+                vm_break();
 
-            case OP_LESS:
-                binary_op(bool, <);
-                break;
+            vm_case(OP_LESS):
+                binary_op_fast(bool, <);
+                vm_break();
 
-            case OP_ADD:
+            vm_case(OP_ADD):
             {
-                if (obj_is_string(vm_stack_peek(0)) &&
-                    obj_is_string(vm_stack_peek(1)))
+                if (value_is_int(vm_stack_peek(0)) &&
+                    value_is_int(vm_stack_peek(1)))
+                {
+                    int64_t b = value_as_int(vm_stack_pop());
+                    int64_t a = value_as_int(vm_stack_pop());
+
+                    vm_stack_push(int_result(a + b));
+                }
+                else if (obj_is_string(vm_stack_peek(0)) &&
+                         obj_is_string(vm_stack_peek(1)))
                 {
                     string_concat();
                 }
@@ -611,90 +1585,143 @@ static InterpretResult run()
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                break;
+                vm_break();
             }
 
-            case OP_SUBTRACT:
-                binary_op(number, -);
-                break;
+            vm_case(OP_SUBTRACT):
+                binary_op_fast(number, -);
+                vm_break();
 
-            case OP_MULTIPLY:
-                binary_op(number, *);
-                break;
+            vm_case(OP_MULTIPLY):
+                binary_op_fast(number, *);
+                vm_break();
 
-            case OP_DIVIDE:
+            vm_case(OP_DIVIDE):
                 binary_op(number, /);
-                break;
+                vm_break();
 
-            case OP_NOT:
+            vm_case(OP_NOT):
                 vm_stack_push(value_make_bool(value_is_falsy(vm_stack_pop())));
-                break;
+                vm_break();
 
-            case OP_NEGATE:
-                if (value_is_number(vm_stack_peek(0)))
+            vm_case(OP_NEGATE):
+                if (!value_is_number(vm_stack_peek(0)))
                 {
                     raise_runtime_error("Operand must be a number");
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                vm_stack_push(
-                    value_make_number(-value_as_number(vm_stack_pop())));
-                break;
+                // Zero stays on the double path so negation still yields
+                // -0.0.
+                if (value_is_int(vm_stack_peek(0)) &&
+                    value_as_int(vm_stack_peek(0)) != 0)
+                {
+                    vm_stack_push(int_result(
+                        -(int64_t)value_as_int(vm_stack_pop())));
+                }
+                else
+                {
+                    vm_stack_push(
+                        value_make_number(-value_as_number(vm_stack_pop())));
+                }
+                vm_break();
 
-            case OP_PRINT:
-                value_print(vm_stack_pop());
-                break;
+            vm_case(OP_PRINT):
+                // Writing can flatten a rope, which allocates and may
+                // collect; the value stays rooted until the write is done,
+                // like the OP_ADD concat path.
+                value_write(vm_stack_peek(0));
+                vm_stack_pop();
+                vm_break();
 
-            case OP_PRINTLN:
-                value_print(vm_stack_pop());
-                puts("");
-                break;
+            vm_case(OP_PRINTLN):
+                value_write(vm_stack_peek(0));
+                vm_stack_pop();
+                vm_out_write("\n", 1);
+                vm_break();
 
-            case OP_JUMP:
+            vm_case(OP_JUMP):
             {
                 uint16_t offset = byte_read_short();
                 frame->ip += offset;
 
-                break;
+                vm_break();
             }
 
-            case OP_JUMP_IF_FALSE:
+            vm_case(OP_JUMP_IF_FALSE):
             {
                 uint16_t offset = byte_read_short();
                 if (value_is_falsy(vm_stack_peek(0))) frame->ip += offset;
 
-                break;
+                vm_break();
             }
 
-            case OP_LOOP:
+            vm_case(OP_LOOP):
             {
                 uint16_t offset = byte_read_short();
                 frame->ip -= offset;
-                break;
+                vm_break();
             }
 
-            case OP_CALL:
+            vm_case(OP_CALL):
             {
                 int argc = byte_read();
                 if (!value_call(vm_stack_peek(argc), argc))
                     return INTERPRET_RUNTIME_ERROR;
 
                 frame = &vm.frames[vm.frame_count - 1];
-                break;
+                vm_break();
+            }
+
+            vm_case(OP_TAIL_CALL):
+            {
+                int argc = byte_read();
+                Value callee = vm_stack_peek(argc);
+
+                // A closure with matching arity reuses the current frame:
+                // captured locals are closed first, then the callee and its
+                // arguments slide down into the frame's slot window. Arena
+                // closures are excluded — their unboxed upvalues point into
+                // the very slots the reuse would overwrite — and fall back
+                // to an ordinary call below.
+                if (obj_is_closure(callee) &&
+                    obj_as_closure(callee)->function->arity == argc &&
+                    !closure_is_arena(obj_as_closure(callee)))
+                {
+                    ObjClosure* closure = obj_as_closure(callee);
+
+                    upvalue_close_until(frame->slots);
+                    memmove(frame->slots, vm.stack_top - argc - 1,
+                            sizeof(Value) * (argc + 1));
+                    vm.stack_top = frame->slots + argc + 1;
+
+                    frame->closure = closure;
+                    frame->ip = closure->function->chunk.code;
+                    vm_break();
+                }
+
+                // Natives, classes, bound methods and arity mismatches take
+                // the ordinary call path and return through the OP_RETURN
+                // the compiler keeps after every tail call.
+                if (!value_call(callee, argc)) return INTERPRET_RUNTIME_ERROR;
+
+                frame = &vm.frames[vm.frame_count - 1];
+                vm_break();
             }
 
-            case OP_INVOKE:
+            vm_case(OP_INVOKE):
             {
                 ObjString* method = byte_read_string();
                 int argc = byte_read();
 
-                if (!invoke(method, argc)) return INTERPRET_RUNTIME_ERROR;
+                if (!invoke(method, argc, prop_cache_get(frame)))
+                    return INTERPRET_RUNTIME_ERROR;
 
                 frame = &vm.frames[vm.frame_count - 1];
-                break;
+                vm_break();
             }
 
-            case OP_SUPER_INVOKE:
+            vm_case(OP_SUPER_INVOKE):
             {
                 ObjString* method = byte_read_string();
                 int argc = byte_read();
@@ -703,10 +1730,10 @@ static InterpretResult run()
                     return INTERPRET_RUNTIME_ERROR;
 
                 frame = &vm.frames[vm.frame_count - 1];
-                break;
+                vm_break();
             }
 
-            case OP_CLOSURE:
+            vm_case(OP_CLOSURE):
             {
                 ObjFunction* function = obj_as_function(byte_read_constant());
                 ObjClosure* closure = obj_closure_new(function);
@@ -726,27 +1753,113 @@ static InterpretResult run()
                     {
                         closure->upvalues[i] = frame->closure->upvalues[index];
                     }
+
+                    gc_barrier_obj((Obj*)closure->upvalues[i]);
+                }
+
+                vm_break();
+            }
+
+            vm_case(OP_CLOSURE_STACK):
+            {
+                // A closure the compiler proved never outlives this frame:
+                // it and its upvalue boxes come out of the bump arena and
+                // captured locals are aimed straight at their stack slots,
+                // skipping both the heap allocations and the open-upvalue
+                // bookkeeping. The slots stay live for as long as the
+                // closure can be called, and the arena rewinds with the
+                // frame. A full arena falls back to the ordinary path.
+                ObjFunction* function = obj_as_function(byte_read_constant());
+                int upvalue_count = function->upvalue_count;
+
+                size_t closure_size = (sizeof(ObjClosure) + 7) & ~(size_t)7;
+                size_t array_size =
+                    (sizeof(ObjUpValue*) * upvalue_count + 7) & ~(size_t)7;
+
+                uint8_t* block = closure_arena_alloc(
+                    closure_size + array_size +
+                    sizeof(ObjUpValue) * upvalue_count);
+
+                ObjClosure* closure;
+                ObjUpValue* boxes = NULL;
+
+                if (block != NULL)
+                {
+                    closure = (ObjClosure*)block;
+                    closure->obj.type = OBJ_CLOSURE;
+                    closure->obj.is_marked = false;
+                    closure->obj.next = NULL;
+                    closure->function = function;
+                    closure->upvalue_count = upvalue_count;
+                    closure->upvalues =
+                        upvalue_count > 0 ? (ObjUpValue**)(block + closure_size)
+                                          : NULL;
+                    boxes = (ObjUpValue*)(block + closure_size + array_size);
+                }
+                else
+                {
+                    closure = obj_closure_new(function);
+                }
+
+                vm_stack_push(value_make_obj(closure));
+
+                for (int i = 0; i < upvalue_count; ++i)
+                {
+                    uint8_t is_local = byte_read();
+                    uint8_t index = byte_read();
+
+                    if (!is_local)
+                    {
+                        closure->upvalues[i] = frame->closure->upvalues[index];
+                    }
+                    else if (boxes != NULL)
+                    {
+                        ObjUpValue* box = &boxes[i];
+                        box->obj.type = OBJ_UPVALUE;
+                        box->obj.is_marked = false;
+                        box->obj.next = NULL;
+                        box->location = frame->slots + index;
+                        box->closed = value_make_nil();
+                        closure->upvalues[i] = box;
+                    }
+                    else
+                    {
+                        closure->upvalues[i] =
+                            upvalue_capture(frame->slots + index);
+                    }
+
+                    gc_barrier_obj((Obj*)closure->upvalues[i]);
                 }
 
-                break;
+                vm_break();
             }
 
-            case OP_CLOSE_UPVALUE:
+            vm_case(OP_CLOSE_UPVALUE):
                 upvalue_close_until(vm.stack_top - 1);
                 vm_stack_pop();
-                break;
+                vm_break();
 
-            case OP_LIST_INIT:
+            vm_case(OP_LIST_INIT):
             {
                 // Stack before: [item1, item2, ..., itemN] and after: [list]
                 ObjList* list = obj_list_new();
                 uint8_t item_count = byte_read();
 
-                // So list isn't sweeped by GC in obj_list_append
+                // So list isn't sweeped by GC while reserving
                 vm_stack_push(value_make_obj(list));
-                // Add items to list
-                for (int i = item_count; i > 0; --i)
-                    obj_list_append(list, vm_stack_peek(i));
+
+                // The backing array is sized once up front, then the items
+                // append straight off the stack: all-number literals land
+                // in the unboxed representation and anything else boxes
+                // the list on the spot.
+                if (item_count > 0)
+                {
+                    obj_list_reserve(list, item_count);
+
+                    Value* items = vm.stack_top - 1 - item_count;
+                    for (int i = 0; i < item_count; ++i)
+                        obj_list_append(list, items[i]);
+                }
 
                 vm_stack_pop();
 
@@ -754,15 +1867,41 @@ static InterpretResult run()
                 while (item_count-- > 0) vm_stack_pop();
 
                 vm_stack_push(value_make_obj(list));
-                break;
+                vm_break();
             }
 
-            case OP_LIST_GETIDX:
+            vm_case(OP_LIST_GETIDX):
             {
                 // Stack before: [list, index] and after: [index(list, index)]
                 Value index = vm_stack_pop();
                 Value list = vm_stack_pop();
 
+                // Maps reach here when the key is not a string literal;
+                // literal keys compile to OP_MAP_GETIDX below.
+                if (obj_is_map(list))
+                {
+                    if (!obj_is_string(index))
+                    {
+                        raise_runtime_error("Map key is not a string.");
+                        return INTERPRET_RUNTIME_ERROR;
+                    }
+
+                    // Canonicalizing may flatten a rope key; keep the map
+                    // and the key rooted across that allocation.
+                    vm_stack_push(list);
+                    vm_stack_push(index);
+                    ObjString* key = map_key_canonical(obj_as_string(index));
+                    vm_stack_pop();
+                    vm_stack_pop();
+
+                    Value result;
+                    if (!table_get(&obj_as_map(list)->table, key, &result))
+                        result = value_make_nil();
+
+                    vm_stack_push(result);
+                    vm_break();
+                }
+
                 if (!obj_as_list(list))
                 {
                     raise_runtime_error("Invalid type to index into.");
@@ -775,26 +1914,55 @@ static InterpretResult run()
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                if (!obj_list_is_valid_index(obj_as_list(list),
-                                             value_as_number(index)))
+                // Canonical indices are tagged integers, which skips the
+                // double round trip.
+                int slot = value_is_int(index) ? value_as_int(index)
+                                               : (int)value_as_number(index);
+
+                if (!obj_list_is_valid_index(obj_as_list(list), slot))
                 {
                     raise_runtime_error("List index out of range");
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                Value result =
-                    obj_list_get(obj_as_list(list), value_as_number(index));
+                Value result = obj_list_get(obj_as_list(list), slot);
                 vm_stack_push(result);
-                break;
+                vm_break();
             }
 
-            case OP_LIST_SETIDX:
+            vm_case(OP_LIST_SETIDX):
             {
                 // Stack before: [list, index, item] and after: [item]
                 Value item = vm_stack_pop();
                 Value index = vm_stack_pop();
                 Value list = vm_stack_pop();
 
+                if (obj_is_map(list))
+                {
+                    if (!obj_is_string(index))
+                    {
+                        raise_runtime_error("Map key is not a string.");
+                        return INTERPRET_RUNTIME_ERROR;
+                    }
+
+                    // The operands and the canonical key must stay rooted
+                    // while canonicalizing and growing the table can both
+                    // collect.
+                    vm_stack_push(list);
+                    vm_stack_push(index);
+                    vm_stack_push(item);
+                    ObjString* key = map_key_canonical(obj_as_string(index));
+                    vm_stack_push(value_make_obj(key));
+                    table_set(&obj_as_map(list)->table, key, item);
+                    vm_stack_pop();
+                    vm_stack_pop();
+                    vm_stack_pop();
+                    vm_stack_pop();
+
+                    vm_stack_push(item);
+                    vm_break();
+                }
+
                 if (!obj_as_list(list))
                 {
                     raise_runtime_error("Invalid type to index into.");
@@ -807,22 +1975,176 @@ static InterpretResult run()
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                if (!obj_list_is_valid_index(obj_as_list(list),
-                                             value_as_number(index)))
+                int slot = value_is_int(index) ? value_as_int(index)
+                                               : (int)value_as_number(index);
+
+                if (!obj_list_is_valid_index(obj_as_list(list), slot))
                 {
                     raise_runtime_error("List index out of range");
                     return INTERPRET_RUNTIME_ERROR;
                 }
 
-                obj_list_set(obj_as_list(list), value_as_number(index), item);
+                obj_list_set(obj_as_list(list), slot, item);
+                vm_stack_push(item);
+                vm_break();
+            }
+
+            vm_case(OP_MAP_GETIDX):
+            {
+                // Stack before: [map] and after: [map[key]]; the key is a
+                // string constant folded into the operand, so it is
+                // interned and flat already.
+                Value key = byte_read_constant();
+                Value map = vm_stack_pop();
+
+                if (!obj_is_map(map))
+                {
+                    raise_runtime_error("Only maps take string keys.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                Value result;
+                if (!table_get(&obj_as_map(map)->table, obj_as_string(key),
+                               &result))
+                    result = value_make_nil();
+
+                vm_stack_push(result);
+                vm_break();
+            }
+
+            vm_case(OP_MAP_SETIDX):
+            {
+                // Stack before: [map, item] and after: [item]; the key is
+                // a string constant folded into the operand.
+                Value key = byte_read_constant();
+                Value item = vm_stack_peek(0);
+                Value map = vm_stack_peek(1);
+
+                if (!obj_is_map(map))
+                {
+                    raise_runtime_error("Only maps take string keys.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                // Growing the table can collect; the operands stay rooted
+                // on the stack until the entry is stored.
+                table_set(&obj_as_map(map)->table, obj_as_string(key), item);
+
+                vm.stack_top -= 2;
                 vm_stack_push(item);
-                break;
+                vm_break();
+            }
+
+            vm_case(OP_GET_LOCAL_CONST_ADD):
+            {
+                Value a = frame->slots[byte_read()];
+                Value b = byte_read_constant();
+
+                if (value_is_int(a) && value_is_int(b))
+                {
+                    vm_stack_push(int_result((int64_t)value_as_int(a) +
+                                             (int64_t)value_as_int(b)));
+                }
+                else if (value_is_number(a) && value_is_number(b))
+                {
+                    vm_stack_push(value_make_number(value_as_number(a) +
+                                                    value_as_number(b)));
+                }
+                else if (obj_is_string(a) && obj_is_string(b))
+                {
+                    // string_concat expects both operands on the stack so
+                    // they stay rooted for the GC.
+                    vm_stack_push(a);
+                    vm_stack_push(b);
+                    string_concat();
+                }
+                else
+                {
+                    raise_runtime_error(
+                        "Operands must be two numbers or two strings.");
+
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                vm_break();
+            }
+
+            vm_case(OP_ADD_SET_LOCAL):
+            {
+                uint8_t slot = byte_read();
+
+                if (value_is_int(vm_stack_peek(0)) &&
+                    value_is_int(vm_stack_peek(1)))
+                {
+                    int64_t b = value_as_int(vm_stack_pop());
+                    int64_t a = value_as_int(vm_stack_pop());
+
+                    vm_stack_push(int_result(a + b));
+                }
+                else if (value_is_number(vm_stack_peek(0)) &&
+                         value_is_number(vm_stack_peek(1)))
+                {
+                    double b = value_as_number(vm_stack_pop());
+                    double a = value_as_number(vm_stack_pop());
+
+                    vm_stack_push(value_make_number(a + b));
+                }
+                else if (obj_is_string(vm_stack_peek(0)) &&
+                         obj_is_string(vm_stack_peek(1)))
+                {
+                    string_concat();
+                }
+                else
+                {
+                    raise_runtime_error(
+                        "Operands must be two numbers or two strings.");
+
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                frame->slots[slot] = vm_stack_peek(0);
+                vm_break();
+            }
+
+            vm_case(OP_LESS_JUMP_IF_FALSE):
+            {
+                uint16_t offset = byte_read_short();
+
+                if (value_is_int(vm_stack_peek(0)) &&
+                    value_is_int(vm_stack_peek(1)))
+                {
+                    int32_t b = value_as_int(vm_stack_pop());
+                    int32_t a = value_as_int(vm_stack_pop());
+
+                    vm_stack_push(value_make_bool(a < b));
+                    if (!(a < b)) frame->ip += offset;
+
+                    vm_break();
+                }
+
+                if (!value_is_number(vm_stack_peek(0)) ||
+                    !value_is_number(vm_stack_peek(1)))
+                {
+                    raise_runtime_error("Operand must be numbers.");
+                    return INTERPRET_RUNTIME_ERROR;
+                }
+
+                double b = value_as_number(vm_stack_pop());
+                double a = value_as_number(vm_stack_pop());
+
+                // Just like OP_LESS followed by OP_JUMP_IF_FALSE, the result
+                // stays on the stack for the statement's OP_POP.
+                vm_stack_push(value_make_bool(a < b));
+                if (!(a < b)) frame->ip += offset;
+
+                vm_break();
             }
 
-            case OP_RETURN:
+            vm_case(OP_RETURN):
             {
                 Value result = vm_stack_pop();
                 upvalue_close_until(frame->slots);
+                vm.closure_arena_count = frame->arena_mark;
                 vm.frame_count--;
                 if (vm.frame_count == 0)
                 {
@@ -833,15 +2155,15 @@ static InterpretResult run()
                 vm.stack_top = frame->slots;
                 vm_stack_push(result);
                 frame = &vm.frames[vm.frame_count - 1];
-                break;
+                vm_break();
             }
 
-            case OP_CLASS:
+            vm_case(OP_CLASS):
                 vm_stack_push(
                     value_make_obj(obj_class_new(byte_read_string())));
-                break;
+                vm_break();
 
-            case OP_INHERIT:
+            vm_case(OP_INHERIT):
             {
                 Value superclass = vm_stack_peek(1);
 
@@ -855,12 +2177,12 @@ static InterpretResult run()
                 table_append(&obj_as_class(superclass)->methods,
                              &subclass->methods);
                 vm_stack_pop(); // Subclass.
-                break;
+                vm_break();
             }
 
-            case OP_METHOD:
+            vm_case(OP_METHOD):
                 define_method(byte_read_string());
-                break;
+                vm_break();
         }
     }
 
@@ -869,13 +2191,25 @@ static InterpretResult run()
 #undef byte_read_constant
 #undef byte_read_string
 #undef binary_op
+#undef binary_op_fast
+#undef int_result_number
+#undef int_result_bool
+#undef trace_execution
+#undef count_instruction
+#ifdef VM_USE_COMPUTED_GOTO
+#undef vm_dispatch
+#endif
+#undef vm_loop_begin
+#undef vm_case
+#undef vm_break
 }
 
-InterpretResult vm_interpret(const char* source)
-{
-    ObjFunction* function = compile(source);
-    if (function == NULL) return INTERPRET_COMPILE_ERROR;
+#ifdef VM_USE_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
 
+InterpretResult vm_interpret_function(ObjFunction* function)
+{
     vm_stack_push(value_make_obj(function));
 
     ObjClosure* closure = obj_closure_new(function);
@@ -883,5 +2217,47 @@ InterpretResult vm_interpret(const char* source)
     vm_stack_push(value_make_obj(closure));
     obj_func_call(closure, 0);
 
-    return run();
+    InterpretResult result = run();
+    vm_out_flush();
+    return result;
+}
+
+InterpretResult vm_interpret(const char* source)
+{
+    ObjFunction* function = compile(source);
+    if (function == NULL) return INTERPRET_COMPILE_ERROR;
+
+    return vm_interpret_function(function);
+}
+
+// Like vm_interpret(), but keeps the compiled top-level function in
+// `repl_cache` keyed by the interned source, so typing the same command
+// again costs a table probe instead of a full scan/parse/compile. Global
+// slot numbering already persists across calls, which is what lets a
+// cached chunk re-run against state defined by later commands.
+InterpretResult vm_interpret_repl(const char* source)
+{
+    ObjString* key = obj_string_cpy(source, (int)strlen(source));
+    vm_stack_push(value_make_obj(key));
+
+    Value cached;
+    if (table_get(&vm.repl_cache, key, &cached))
+    {
+        vm_stack_pop();
+        return vm_interpret_function(obj_as_function(cached));
+    }
+
+    ObjFunction* function = compile(source);
+    if (function == NULL)
+    {
+        vm_stack_pop();
+        return INTERPRET_COMPILE_ERROR;
+    }
+
+    vm_stack_push(value_make_obj(function));
+    table_set(&vm.repl_cache, key, value_make_obj(function));
+    vm_stack_pop();
+    vm_stack_pop();
+
+    return vm_interpret_function(function);
 }
\ No newline at end of file
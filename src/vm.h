@@ -7,12 +7,22 @@
 
 #define FRAMES_MAX 64
 #define STACK_MAX (FRAMES_MAX * UINT8_COUNT)
+#define VM_OUT_BUFFER_SIZE 65536
+#define CLOSURE_ARENA_SIZE (32 * 1024)
+
+#ifdef VM_STATS
+// GC pause and reclaimed-bytes histograms share one bucket layout; the
+// bucket limits live in src/memory.c.
+#define VM_STATS_BUCKET_COUNT 5
+#endif
 
 typedef struct
 {
     ObjClosure* closure;
     uint8_t* ip;
     Value* slots;
+    // Closure arena watermark at entry; returning rewinds to it.
+    int arena_mark;
 } CallFrame;
 
 typedef struct
@@ -22,13 +32,67 @@ typedef struct
 
     Value stack[STACK_MAX];
     Value* stack_top;
-    Table globals;
+
+    // Globals live in the flat `global_slots` array; `global_names` maps an
+    // interned name to its slot index so the compiler can resolve most
+    // accesses to a single array load at compile time.
+    Table global_names;
+    ValueArray global_slots;
+
     Table strings;
     ObjString* init_str;
-    ObjUpValue* open_upvalues;
+    // Open upvalues indexed by the stack slot they capture: capture is a
+    // single array load and closing scans only the slot window being
+    // unwound, so deep closure pipelines never rescan every open upvalue
+    // on the thread. The count lets the common no-upvalues case skip the
+    // window scans entirely.
+    ObjUpValue* open_upvalues[STACK_MAX];
+    int open_upvalue_count;
+
+    // Values pinned by native modules through vm_pin(); scanned as roots.
+    ValueArray pins;
+
+    // REPL chunk cache: interned source string -> compiled top-level
+    // function, so re-entered commands skip the compiler entirely. Only
+    // vm_interpret_repl() writes to it; batch runs leave it empty.
+    Table repl_cache;
+
+    // Buffered program output: OP_PRINT/OP_PRINTLN append here through
+    // value_write() and the buffer is flushed in large writes. `out_fd`
+    // defaults to stdout and can be redirected by the out_redirect()
+    // native; `out_owns_fd` marks descriptors the VM opened itself.
+    char out_buffer[VM_OUT_BUFFER_SIZE];
+    int out_count;
+    int out_fd;
+    bool out_owns_fd;
+
+    // Bump arena backing closures the compiler proved non-escaping
+    // (OP_CLOSURE_STACK) and their upvalue boxes. Objects here carry
+    // ordinary headers so the collector can traverse them, but they are
+    // never registered for sweeping: their storage dies when the owning
+    // frame rewinds the watermark. Exhaustion falls back to the heap.
+    _Alignas(8) uint8_t closure_arena[CLOSURE_ARENA_SIZE];
+    int closure_arena_count;
+
+#ifdef VM_STATS
+    // Low-overhead instrumentation: flat arrays bumped on the dispatch and
+    // allocation paths, cheap enough to leave enabled in staging. Dumped on
+    // demand by the stats() native and consumed by the bench harness.
+    uint64_t instructions_executed;
+    size_t peak_bytes_allocated;
+    uint64_t opcode_counts[OP_CODE_COUNT];
+    uint64_t alloc_counts[OBJ_TYPE_COUNT];
+    uint64_t gc_cycles;
+    uint64_t gc_pause_buckets[VM_STATS_BUCKET_COUNT];
+    uint64_t gc_reclaim_buckets[VM_STATS_BUCKET_COUNT];
+#endif
 
     size_t bytes_allocated;
     size_t next_gc;
+    // Tunables read from the environment in vm_init(); gc_enabled gates
+    // the automatic triggers only — gc_collect() always runs.
+    double gc_grow_factor;
+    bool gc_enabled;
     Obj* objects;
     int gray_count;
     int gray_capacity;
@@ -43,12 +107,24 @@ typedef enum
     INTERPRET_RUNTIME_ERROR,
 } InterpretResult;
 
-extern VM vm;
+extern _Thread_local VM vm;
+
+// Reports a runtime error against the current thread's VM and unwinds its
+// stack; native functions outside vm.c use it too.
+void raise_runtime_error(const char* format, ...);
 
 void vm_init();
 void vm_free();
 InterpretResult vm_interpret(const char* source);
+InterpretResult vm_interpret_function(ObjFunction* function);
+InterpretResult vm_interpret_repl(const char* source);
+void vm_define_native_fn(const char* name, NativeFn function);
+
+void vm_out_write(const char* chars, int length);
+void vm_out_flush();
+
 void vm_stack_push(Value value);
 Value vm_stack_pop();
+int vm_global_slot(ObjString* name);
 
 #endif // CLOX_VM_H_
@@ -0,0 +1,398 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "object.h"
+#include "value.h"
+#include "vm.h"
+#include "worker.h"
+
+#define WORKERS_MAX 64
+#define CHANNELS_MAX 64
+#define CHANNEL_CAPACITY 256
+
+// Values cross VM boundaries as plain C copies, never as heap pointers:
+// the sender flattens into a Msg and the receiver rebuilds the value in
+// its own heap. Only immutable values are copyable, which is what keeps
+// the per-thread heaps free of cross-VM references.
+typedef enum
+{
+    MSG_NIL,
+    MSG_BOOL,
+    MSG_NUMBER,
+    MSG_STRING,
+} MsgType;
+
+typedef struct
+{
+    MsgType type;
+    bool boolean;
+    double number;
+    char* chars;
+    int length;
+} Msg;
+
+typedef struct
+{
+    pthread_t thread;
+    char* source;
+    Msg arg;
+    int status;
+    bool used;
+    bool joined;
+} Worker;
+
+typedef struct
+{
+    Msg items[CHANNEL_CAPACITY];
+    int head;
+    int count;
+    bool used;
+    pthread_mutex_t mutex;
+    pthread_cond_t readable;
+    pthread_cond_t writable;
+} Channel;
+
+// The worker and channel tables are the only state shared between threads;
+// everything the scripts touch stays in per-thread heaps.
+static Worker workers[WORKERS_MAX];
+static int worker_count = 0;
+static pthread_mutex_t worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static Channel channels[CHANNELS_MAX];
+static int channel_count = 0;
+static pthread_mutex_t channel_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static _Thread_local Worker* current_worker = NULL;
+
+static bool msg_from_value(Value value, Msg* out)
+{
+    if (value_is_nil(value))
+    {
+        out->type = MSG_NIL;
+        return true;
+    }
+
+    if (value_is_bool(value))
+    {
+        out->type = MSG_BOOL;
+        out->boolean = value_as_bool(value);
+        return true;
+    }
+
+    if (value_is_number(value))
+    {
+        out->type = MSG_NUMBER;
+        out->number = value_as_number(value);
+        return true;
+    }
+
+    if (obj_is_string(value))
+    {
+        ObjString* string = obj_as_string(value);
+        char* chars = obj_string_chars(string);
+
+        out->type = MSG_STRING;
+        out->length = string->length;
+        out->chars = malloc(string->length + 1);
+        if (out->chars == NULL) exit(1);
+        memcpy(out->chars, chars, string->length + 1);
+        return true;
+    }
+
+    return false;
+}
+
+// Rebuilds the message in the calling thread's VM heap.
+static Value msg_to_value(Msg* msg)
+{
+    switch (msg->type)
+    {
+        case MSG_NIL:
+            return value_make_nil();
+
+        case MSG_BOOL:
+            return value_make_bool(msg->boolean);
+
+        case MSG_NUMBER:
+            return value_make_number(msg->number);
+
+        case MSG_STRING:
+            return value_make_obj(obj_string_cpy(msg->chars, msg->length));
+    }
+
+    return value_make_nil(); // Unreachable.
+}
+
+static void msg_free(Msg* msg)
+{
+    if (msg->type == MSG_STRING) free(msg->chars);
+    msg->type = MSG_NIL;
+    msg->chars = NULL;
+}
+
+// Like main.c's file_read, but failures surface as runtime errors in the
+// spawning script instead of exiting the process.
+static char* source_read(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+
+    fseek(file, 0l, SEEK_END);
+    size_t file_size = ftell(file);
+    rewind(file);
+
+    char* buffer = malloc(file_size + 1);
+    if (buffer == NULL) exit(1);
+
+    if (fread(buffer, sizeof(char), file_size, file) < file_size)
+    {
+        free(buffer);
+        fclose(file);
+        return NULL;
+    }
+
+    buffer[file_size] = '\0';
+    fclose(file);
+    return buffer;
+}
+
+static void* worker_main(void* arg)
+{
+    Worker* worker = (Worker*)arg;
+    current_worker = worker;
+
+    vm_init();
+    worker->status = (int)vm_interpret(worker->source);
+    vm_free();
+
+    return NULL;
+}
+
+static Value native_fn_spawn(int argc, Value* args)
+{
+    if (argc != 1 && argc != 2)
+    {
+        raise_runtime_error("insufficient arguments, need 1 or 2 got=%d",
+                            argc);
+        return value_make_nil();
+    }
+
+    if (!obj_is_string(args[0]))
+    {
+        raise_runtime_error("worker script path must be a string.");
+        return value_make_nil();
+    }
+
+    Msg arg = {.type = MSG_NIL};
+    if (argc == 2 && !msg_from_value(args[1], &arg))
+    {
+        raise_runtime_error(
+            "can only pass nil, booleans, numbers and strings to a worker.");
+        return value_make_nil();
+    }
+
+    char* source = source_read(obj_string_chars(obj_as_string(args[0])));
+    if (source == NULL)
+    {
+        msg_free(&arg);
+        raise_runtime_error("could not read worker script '%s'.",
+                            obj_string_chars(obj_as_string(args[0])));
+        return value_make_nil();
+    }
+
+    pthread_mutex_lock(&worker_mutex);
+
+    if (worker_count == WORKERS_MAX)
+    {
+        pthread_mutex_unlock(&worker_mutex);
+        free(source);
+        msg_free(&arg);
+        raise_runtime_error("too many workers (max %d).", WORKERS_MAX);
+        return value_make_nil();
+    }
+
+    int id = worker_count++;
+    Worker* worker = &workers[id];
+    worker->source = source;
+    worker->arg = arg;
+    worker->status = -1;
+    worker->used = true;
+    worker->joined = false;
+
+    if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0)
+    {
+        worker->used = false;
+        worker_count--;
+        pthread_mutex_unlock(&worker_mutex);
+        free(source);
+        msg_free(&arg);
+        raise_runtime_error("could not start worker thread.");
+        return value_make_nil();
+    }
+
+    pthread_mutex_unlock(&worker_mutex);
+    return value_make_number(id);
+}
+
+static Value native_fn_join(int argc, Value* args)
+{
+    if (argc != 1 || !value_is_number(args[0]))
+    {
+        raise_runtime_error("join expects a worker id.");
+        return value_make_nil();
+    }
+
+    int id = (int)value_as_number(args[0]);
+
+    pthread_mutex_lock(&worker_mutex);
+    bool valid = id >= 0 && id < worker_count && workers[id].used &&
+                 !workers[id].joined;
+    if (valid) workers[id].joined = true;
+    pthread_mutex_unlock(&worker_mutex);
+
+    if (!valid)
+    {
+        raise_runtime_error("invalid or already joined worker id.");
+        return value_make_nil();
+    }
+
+    Worker* worker = &workers[id];
+    pthread_join(worker->thread, NULL);
+
+    free(worker->source);
+    worker->source = NULL;
+    msg_free(&worker->arg);
+
+    return value_make_bool(worker->status == (int)INTERPRET_OK);
+}
+
+static Value native_fn_worker_arg(int argc, Value* args)
+{
+    (void)argc;
+    (void)args;
+
+    if (current_worker == NULL) return value_make_nil();
+
+    return msg_to_value(&current_worker->arg);
+}
+
+static Value native_fn_chan_make(int argc, Value* args)
+{
+    (void)argc;
+    (void)args;
+
+    pthread_mutex_lock(&channel_mutex);
+
+    if (channel_count == CHANNELS_MAX)
+    {
+        pthread_mutex_unlock(&channel_mutex);
+        raise_runtime_error("too many channels (max %d).", CHANNELS_MAX);
+        return value_make_nil();
+    }
+
+    int id = channel_count++;
+    Channel* channel = &channels[id];
+    channel->head = 0;
+    channel->count = 0;
+    channel->used = true;
+    pthread_mutex_init(&channel->mutex, NULL);
+    pthread_cond_init(&channel->readable, NULL);
+    pthread_cond_init(&channel->writable, NULL);
+
+    pthread_mutex_unlock(&channel_mutex);
+    return value_make_number(id);
+}
+
+static Channel* channel_resolve(Value id_value)
+{
+    if (!value_is_number(id_value)) return NULL;
+
+    int id = (int)value_as_number(id_value);
+
+    pthread_mutex_lock(&channel_mutex);
+    bool valid = id >= 0 && id < channel_count && channels[id].used;
+    pthread_mutex_unlock(&channel_mutex);
+
+    return valid ? &channels[id] : NULL;
+}
+
+static Value native_fn_chan_send(int argc, Value* args)
+{
+    if (argc != 2)
+    {
+        raise_runtime_error("insufficient arguments, need 2 got=%d", argc);
+        return value_make_nil();
+    }
+
+    Channel* channel = channel_resolve(args[0]);
+    if (channel == NULL)
+    {
+        raise_runtime_error("invalid channel id.");
+        return value_make_nil();
+    }
+
+    Msg msg;
+    if (!msg_from_value(args[1], &msg))
+    {
+        raise_runtime_error(
+            "can only send nil, booleans, numbers and strings.");
+        return value_make_nil();
+    }
+
+    pthread_mutex_lock(&channel->mutex);
+
+    while (channel->count == CHANNEL_CAPACITY)
+        pthread_cond_wait(&channel->writable, &channel->mutex);
+
+    channel->items[(channel->head + channel->count) % CHANNEL_CAPACITY] = msg;
+    channel->count++;
+
+    pthread_cond_signal(&channel->readable);
+    pthread_mutex_unlock(&channel->mutex);
+
+    return value_make_nil();
+}
+
+static Value native_fn_chan_recv(int argc, Value* args)
+{
+    if (argc != 1)
+    {
+        raise_runtime_error("insufficient arguments, need 1 got=%d", argc);
+        return value_make_nil();
+    }
+
+    Channel* channel = channel_resolve(args[0]);
+    if (channel == NULL)
+    {
+        raise_runtime_error("invalid channel id.");
+        return value_make_nil();
+    }
+
+    pthread_mutex_lock(&channel->mutex);
+
+    while (channel->count == 0)
+        pthread_cond_wait(&channel->readable, &channel->mutex);
+
+    Msg msg = channel->items[channel->head];
+    channel->head = (channel->head + 1) % CHANNEL_CAPACITY;
+    channel->count--;
+
+    pthread_cond_signal(&channel->writable);
+    pthread_mutex_unlock(&channel->mutex);
+
+    Value value = msg_to_value(&msg);
+    msg_free(&msg);
+    return value;
+}
+
+void worker_natives_define()
+{
+    vm_define_native_fn("spawn", native_fn_spawn);
+    vm_define_native_fn("join", native_fn_join);
+    vm_define_native_fn("worker_arg", native_fn_worker_arg);
+    vm_define_native_fn("chan_make", native_fn_chan_make);
+    vm_define_native_fn("chan_send", native_fn_chan_send);
+    vm_define_native_fn("chan_recv", native_fn_chan_recv);
+}
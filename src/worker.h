@@ -0,0 +1,18 @@
+#ifndef CLOX_WORKER_H_
+#define CLOX_WORKER_H_
+
+// Worker VMs on native threads. Every thread owns a full interpreter
+// instance (the VM globals are thread-local), so workers get isolated
+// heaps, intern tables and collectors for free; they communicate through
+// copy-on-send channels instead of shared objects.
+//
+// Natives registered by worker_natives_define():
+//   spawn(path[, arg]) -> worker id, runs the script file on a new thread
+//   join(id)           -> true when the worker script finished cleanly
+//   worker_arg()       -> the value passed to spawn, copied into this VM
+//   chan_make()        -> channel id, shared by all workers
+//   chan_send(id, v)   -> blocks while the channel is full
+//   chan_recv(id)      -> blocks until a value arrives
+void worker_natives_define();
+
+#endif // CLOX_WORKER_H_